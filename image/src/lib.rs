@@ -3,7 +3,8 @@
 use {
     proc_macro::{Span, TokenStream},
     proc_macro2::Ident,
-    quote::{quote, TokenStreamExt},
+    quote::quote,
+    std::{env, fs, path::PathBuf},
     syn::{
         parse::{self, ParseStream},
         parse_macro_input, LitStr, Token,
@@ -22,21 +23,40 @@ impl parse::Parse for Input {
     }
 }
 
+/// Decodes an image into rows of RGB texels, stores them as `OUT_DIR/<stem>.rgb` and defines
+/// `static $name: (&[u8], usize, usize)` with the texels, width and height. The texels are pulled
+/// in with `include_bytes!` instead of one token per byte, so large textures cost little more
+/// to build than to decode.
 #[proc_macro]
 pub fn load(input: TokenStream) -> TokenStream {
     let cwf = Span::call_site().source_file().path();
     let cwd = cwf.parent().unwrap();
 
     let Input { path, name, .. } = parse_macro_input!(input as Input);
-    let image = image::open(cwd.join(path.value())).unwrap().to_rgb8();
+    let source = cwd.join(path.value()).canonicalize().unwrap();
+    let image = image::open(&source).unwrap().to_rgb8();
+    let (w, h) = image.dimensions();
 
-    let mut repr = quote! {};
-    for image::Rgb([r, g, b]) in image.pixels() {
-        repr.append_all(quote!(#r, #g, #b, ));
+    let out = PathBuf::from(env::var("OUT_DIR").expect("`image::load!` needs a build script"));
+    let blob = out.join(format!("{}.rgb", source.file_stem().unwrap().to_str().unwrap()));
+    // rewritten only when it changes, so that it does not look newer than the build every time
+    if fs::read(&blob).ok().as_deref() != Some(image.as_raw().as_slice()) {
+        fs::write(&blob, image.as_raw()).unwrap();
     }
 
-    let len = image.pixels().count();
-    let (w, h) = image.dimensions();
-    quote!(static #name: ([u8; #len * 3], usize, usize) = ([#repr], #w as usize, #h as usize);)
-        .into()
+    let len = image.as_raw().len();
+    let (source, blob) = (source.display().to_string(), blob.display().to_string());
+    quote! {
+        static #name: (&[u8], usize, usize) = {
+            // lets cargo rebuild when the image changes, and is never emitted itself
+            const _: &[u8] = include_bytes!(#source);
+
+            // texels start on a cache line, as tiles of the converted texture do
+            #[repr(C, align(64))]
+            struct Aligned<B>(B);
+            static TEXELS: Aligned<[u8; #len]> = Aligned(*include_bytes!(#blob));
+            (&TEXELS.0, #w as usize, #h as usize)
+        };
+    }
+    .into()
 }
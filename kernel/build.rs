@@ -1,3 +1,10 @@
+use std::{collections::HashMap, env, fs, path::Path};
+
+// layout of `model::MeshHeader`, followed by `vertices_len` of `model::Vertex` and `indices_len`
+// of `u32`, three per triangle
+const MESH_MAGIC: [u8; 4] = *b"MESH";
+const MESH_VERSION: u32 = 2;
+
 fn main() {
     println!("cargo:rerun-if-changed=cc/main.cxx");
     println!("cargo:rerun-if-changed=cc/CMakeLists.txt");
@@ -11,4 +18,57 @@ fn main() {
         "cargo:rustc-link-search={}",
         format!("{}{}", env!("CARGO_MANIFEST_DIR"), "/cc/build/")
     );
+
+    bake_meshes(
+        &Path::new(env!("CARGO_MANIFEST_DIR")).join("assets"),
+        Path::new(&env::var("OUT_DIR").unwrap()),
+    );
+}
+
+/// Converts every `assets/<name>.obj` into `OUT_DIR/<name>.mesh`, which the kernel embeds and
+/// hands to the renderer as is. Corners of faces sharing both position and uv become one vertex.
+fn bake_meshes(assets: &Path, out: &Path) {
+    println!("cargo:rerun-if-changed={}", assets.display());
+
+    for entry in fs::read_dir(assets).unwrap() {
+        let path = entry.unwrap().path();
+        if path.extension().map_or(true, |ext| ext != "obj") {
+            continue;
+        }
+        println!("cargo:rerun-if-changed={}", path.display());
+
+        let text = fs::read_to_string(&path).unwrap();
+        let obj = wavefront::Obj::from_lines(text.lines()).unwrap();
+
+        let mut unique = HashMap::new();
+        let mut vertices = Vec::new();
+        let mut indices = Vec::new();
+        for t in obj.triangles() {
+            for corner in t {
+                let [x, y, z] = corner.position();
+                let Some([u, v, _]) = corner.uv() else {
+                    panic!("{}: vertex without uv", path.display());
+                };
+                // the renderer samples with the first two uv coordinates only
+                let key = [x, y, z, u, v].map(f32::to_bits);
+                let next = unique.len() as u32;
+                let idx = *unique.entry(key).or_insert_with(|| {
+                    vertices.extend(key.iter().flat_map(|bits| bits.to_le_bytes()));
+                    next
+                });
+                indices.extend(idx.to_le_bytes());
+            }
+        }
+
+        let mut blob = Vec::with_capacity(16 + vertices.len() + indices.len());
+        blob.extend(MESH_MAGIC);
+        blob.extend(MESH_VERSION.to_le_bytes());
+        blob.extend((unique.len() as u32).to_le_bytes());
+        blob.extend((indices.len() as u32 / 4).to_le_bytes());
+        blob.extend(vertices);
+        blob.extend(indices);
+
+        let name = path.file_stem().unwrap().to_str().unwrap();
+        fs::write(out.join(format!("{name}.mesh")), blob).unwrap();
+    }
 }
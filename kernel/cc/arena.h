@@ -0,0 +1,59 @@
+#pragma once
+
+#include "std/algorithm"
+#include "std/cstdint"
+
+extern "C" void *malloc(size_t);
+
+// Bump allocator over one contiguous block for data that lives until the next `reset`: an
+// allocation is an add, and a reset drops all of them at once. Allocations start on a cache line,
+// so buffers written by different cpus never share one.
+struct Arena {
+  static constexpr size_t ALIGN = 64;
+
+  uint8_t *base = nullptr;
+  size_t capacity = 0;
+  size_t used = 0;
+  // bytes asked for since `reset`, more than `capacity` if the block ran out
+  size_t wanted = 0;
+
+  Arena() = default;
+
+  explicit Arena(size_t capacity) {
+    grow(capacity);
+  }
+
+  // Room for `len` values of `T`, uninitialized.
+  template <typename T>
+  [[nodiscard]] auto alloc(size_t len) -> T * {
+    static_assert(alignof(T) <= ALIGN);
+    auto size = (len * sizeof(T) + ALIGN - 1) & ~(ALIGN - 1);
+    wanted += size;
+    if (used + size > capacity) {
+      // served from the heap until `reset` makes the block large enough
+      return (T *)aligned(malloc(size + ALIGN - 1));
+    }
+    auto ptr = base + used;
+    used += size;
+    return (T *)ptr;
+  }
+
+  void reset() {
+    if (wanted > capacity) {
+      // `free` is a no-op, so grow geometrically to reallocate only a few times
+      grow(std::max(wanted, capacity * 2));
+    }
+    used = 0;
+    wanted = 0;
+  }
+
+ private:
+  void grow(size_t bytes) {
+    capacity = bytes;
+    base = aligned(malloc(capacity + ALIGN - 1));
+  }
+
+  static auto aligned(void *ptr) -> uint8_t * {
+    return (uint8_t *)(((uintptr_t)ptr + ALIGN - 1) & ~(ALIGN - 1));
+  }
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "std/algorithm"
+#include "std/cstdint"
+#include "std/span"
+#include "arena.h"
+
+// Inclusive pixel rectangle.
+struct Rect {
+  int32_t x0, y0, x1, y1;
+
+  static constexpr auto nothing() -> Rect {
+    return {0, 0, -1, -1};
+  }
+
+  [[nodiscard]] constexpr auto empty() const -> bool {
+    return x0 > x1 || y0 > y1;
+  }
+
+  [[nodiscard]] constexpr auto unite(Rect other) const -> Rect {
+    if (empty()) {
+      return other;
+    }
+    if (other.empty()) {
+      return *this;
+    }
+    return {std::min(x0, other.x0), std::min(y0, other.y0), std::max(x1, other.x1),
+            std::max(y1, other.y1)};
+  }
+
+  [[nodiscard]] constexpr auto intersect(Rect other) const -> Rect {
+    return {std::max(x0, other.x0), std::max(y0, other.y0), std::min(x1, other.x1),
+            std::min(y1, other.y1)};
+  }
+};
+
+// Screen of `W`x`H` pixels split into `TILE`x`TILE` tiles, each one with the list of primitives
+// whose bounding box overlaps it. Lists keep submission order, so drawing a tile list front to back
+// gives the same result as drawing every primitive over the whole screen.
+template <size_t W, size_t H, size_t TILE>
+struct TileBins {
+  static constexpr size_t COLS = (W + TILE - 1) / TILE;
+  static constexpr size_t ROWS = (H + TILE - 1) / TILE;
+
+  // list of tile `i` is `items[start[i]..start[i + 1]]`
+  uint32_t start[COLS * ROWS + 1] = {0};
+  uint32_t *items = nullptr;
+
+  [[nodiscard]] static constexpr auto rect(size_t col, size_t row) -> Rect {
+    return {int32_t(col * TILE), int32_t(row * TILE),
+            int32_t(std::min((col + 1) * TILE, W) - 1), int32_t(std::min((row + 1) * TILE, H) - 1)};
+  }
+
+  [[nodiscard]] auto tile(size_t col, size_t row) const -> std::span<const uint32_t> {
+    auto idx = row * COLS + col;
+    return {items + start[idx], items + start[idx + 1]};
+  }
+
+  // Counting sort of `len` primitives by tile: `bbox(i)` is the on-screen bounding box of the
+  // primitive `i`, an empty one keeps it out of every list. The lists live in `arena`.
+  template <typename F>
+  void build(size_t len, F bbox, Arena &arena) {
+    uint32_t fill[COLS * ROWS] = {0};
+
+    for (size_t i = 0; i < len; i++) {
+      for_tiles(bbox(i), [&](size_t idx) { fill[idx]++; });
+    }
+
+    size_t total = 0;
+    for (size_t idx = 0; idx < COLS * ROWS; idx++) {
+      start[idx] = total;
+      total += fill[idx];
+      fill[idx] = start[idx];
+    }
+    start[COLS * ROWS] = total;
+
+    items = arena.alloc<uint32_t>(total);
+
+    for (size_t i = 0; i < len; i++) {
+      for_tiles(bbox(i), [&](size_t idx) { items[fill[idx]++] = i; });
+    }
+  }
+
+ private:
+  template <typename F>
+  static void for_tiles(Rect bbox, F f) {
+    if (bbox.empty()) {
+      return;
+    }
+    for (size_t row = bbox.y0 / TILE; row <= bbox.y1 / TILE; row++) {
+      for (size_t col = bbox.x0 / TILE; col <= bbox.x1 / TILE; col++) {
+        f(row * COLS + col);
+      }
+    }
+  }
+};
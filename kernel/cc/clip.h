@@ -0,0 +1,126 @@
+#pragma once
+
+#include "std/algorithm"
+#include "std/cstdint"
+#include "bin.h"
+#include "types.h"
+
+// Half-space of homogeneous points `p` with `normal . p + offset >= 0`.
+struct Plane {
+  vec4f normal;
+  float_t offset;
+
+  [[nodiscard]] auto distance(const vec4f &p) const -> float_t {
+    return normal.dot(p) + offset;
+  }
+};
+
+// Triangles in homogeneous screen space, after the viewport and before the divide by w. Those
+// entirely beyond one side of the view frustum are dropped, those within the near plane and the
+// guard band around the screen are drawn as they are, and only the rest are clipped. Pixels of the
+// guard band are never visited, since bounding boxes are cut to the screen, but it keeps the
+// projected vertices within range of the fixed-point rasterizer.
+struct Clipper {
+  enum Result { Reject, Accept, Split };
+
+  // near plane, then the left, right, top and bottom sides of the screen and of the guard band
+  static constexpr size_t PLANES = 9;
+  static constexpr uint32_t FRUSTUM = 0b000011111;
+  static constexpr uint32_t GUARD = 0b111100001;
+  // a convex polygon gains at most one vertex per plane
+  static constexpr size_t MAX_VERTS = 3 + 5;
+
+  Plane planes[PLANES];
+
+  Clipper() = default;
+
+  // `near` is the distance of the near plane from the eye, `band` the width of the guard band in
+  // pixels.
+  Clipper(Rect screen, float_t near, float_t band) {
+    auto x0 = float_t(screen.x0), y0 = float_t(screen.y0);
+    auto x1 = float_t(screen.x1 + 1), y1 = float_t(screen.y1 + 1);
+    // depth is the eye space z, which is negative in front of the eye
+    planes[0] = {{0, 0, -1, 0}, -near};
+    for (size_t i = 0; i < 2; i++) {
+      auto grow = i ? band : 0;
+      planes[1 + i * 4] = {{1, 0, 0, grow - x0}, 0};
+      planes[2 + i * 4] = {{-1, 0, 0, x1 + grow}, 0};
+      planes[3 + i * 4] = {{0, 1, 0, grow - y0}, 0};
+      planes[4 + i * 4] = {{0, -1, 0, y1 + grow}, 0};
+    }
+  }
+
+  [[nodiscard]] auto classify(const vec4f pts[3]) const -> Result {
+    uint32_t all = ~0u, any = 0;
+    for (size_t i = 0; i < 3; i++) {
+      auto code = outcode(pts[i]);
+      all &= code;
+      any |= code;
+    }
+    if (all & FRUSTUM) {
+      return Reject;
+    }
+    return (any & GUARD) ? Split : Accept;
+  }
+
+  // Clips a triangle against the near plane and the guard band and calls `emit(tri, bc)` for each
+  // triangle of the remaining polygon, where the columns of `bc` are the barycentric weights of its
+  // vertices in the original triangle.
+  template <typename F>
+  void split(const vec4f pts[3], F emit) const {
+    vec4f poly[MAX_VERTS] = {pts[0], pts[1], pts[2]};
+    vec3f bc[MAX_VERTS] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    size_t len = 3;
+
+    // clipped polygons stay within the original triangle, so planes it does not cross are skipped
+    uint32_t crossed = (outcode(pts[0]) | outcode(pts[1]) | outcode(pts[2])) & GUARD;
+    for (size_t i = 0; i < PLANES; i++) {
+      if (!(crossed >> i & 1)) {
+        continue;
+      }
+      vec4f out_poly[MAX_VERTS];
+      vec3f out_bc[MAX_VERTS];
+      size_t out_len = 0;
+      for (size_t a = 0; a < len; a++) {
+        auto b = (a + 1) % len;
+        auto da = planes[i].distance(poly[a]), db = planes[i].distance(poly[b]);
+        if (da >= 0) {
+          out_poly[out_len] = poly[a];
+          out_bc[out_len++] = bc[a];
+        }
+        if ((da >= 0) != (db >= 0)) {
+          // always interpolated from the inner end, so both triangles sharing the edge agree
+          auto in = da >= 0 ? a : b, out = da >= 0 ? b : a;
+          float_t t = (da >= 0 ? da : db) / (da >= 0 ? da - db : db - da);
+          out_poly[out_len] = poly[in] + (poly[out] - poly[in]) * t;
+          out_bc[out_len++] = bc[in] + (bc[out] - bc[in]) * t;
+        }
+      }
+      if (out_len < 3) {
+        return;
+      }
+      std::copy_n(out_poly, out_len, poly);
+      std::copy_n(out_bc, out_len, bc);
+      len = out_len;
+    }
+
+    for (size_t i = 1; i + 1 < len; i++) {
+      vec4f tri[3] = {poly[0], poly[i], poly[i + 1]};
+      mat3x3 weights;
+      weights.set_col(0, bc[0]);
+      weights.set_col(1, bc[i]);
+      weights.set_col(2, bc[i + 1]);
+      emit(tri, weights);
+    }
+  }
+
+ private:
+  // bit `i` is set when the point is outside of `planes[i]`
+  [[nodiscard]] auto outcode(const vec4f &p) const -> uint32_t {
+    uint32_t code = 0;
+    for (size_t i = 0; i < PLANES; i++) {
+      code |= uint32_t(planes[i].distance(p) < 0) << i;
+    }
+    return code;
+  }
+};
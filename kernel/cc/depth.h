@@ -0,0 +1,72 @@
+#pragma once
+
+#include "std/algorithm"
+#include "std/cstdint"
+#include "types.h"
+
+// Depth range of a group of pixels; larger depth is nearer to the eye.
+struct DepthBounds {
+  float_t far;
+  float_t near;
+};
+
+// Coarse levels over a `W`x`H` depth buffer: depth bounds of every `BLOCK`x`BLOCK` block and of
+// every `TILE`x`TILE` tile. A triangle whose nearest depth is behind the far bound of a block fails
+// the depth test on every pixel of it, and one whose farthest depth is in front of the near bound
+// passes it everywhere.
+template <size_t W, size_t H, size_t BLOCK, size_t TILE>
+struct HiZ {
+  static_assert(TILE % BLOCK == 0);
+
+  static constexpr size_t BLOCK_COLS = (W + BLOCK - 1) / BLOCK;
+  static constexpr size_t BLOCK_ROWS = (H + BLOCK - 1) / BLOCK;
+  static constexpr size_t TILE_COLS = (W + TILE - 1) / TILE;
+  static constexpr size_t TILE_ROWS = (H + TILE - 1) / TILE;
+
+  DepthBounds blocks[BLOCK_ROWS * BLOCK_COLS];
+  DepthBounds tiles[TILE_ROWS * TILE_COLS];
+
+  void clear(float_t depth) {
+    for (auto &it : blocks) {
+      it = {depth, depth};
+    }
+    for (auto &it : tiles) {
+      it = {depth, depth};
+    }
+  }
+
+  auto block(size_t bx, size_t by) -> DepthBounds & {
+    return blocks[by * BLOCK_COLS + bx];
+  }
+
+  auto tile(size_t col, size_t row) -> DepthBounds & {
+    return tiles[row * TILE_COLS + col];
+  }
+
+  // Recomputes the bounds of a block after some of its pixels were written.
+  void refresh_block(const float_t *z_buffer, size_t bx, size_t by) {
+    auto first = z_buffer[by * BLOCK * W + bx * BLOCK];
+    DepthBounds bounds = {first, first};
+    for (size_t y = by * BLOCK; y < std::min((by + 1) * BLOCK, H); y++) {
+      for (size_t x = bx * BLOCK; x < std::min((bx + 1) * BLOCK, W); x++) {
+        bounds.far = std::min(bounds.far, z_buffer[y * W + x]);
+        bounds.near = std::max(bounds.near, z_buffer[y * W + x]);
+      }
+    }
+    block(bx, by) = bounds;
+  }
+
+  // Recomputes the bounds of a tile from its blocks.
+  void refresh_tile(size_t col, size_t row) {
+    constexpr size_t N = TILE / BLOCK;
+
+    DepthBounds bounds = block(col * N, row * N);
+    for (size_t by = row * N; by < std::min((row + 1) * N, BLOCK_ROWS); by++) {
+      for (size_t bx = col * N; bx < std::min((col + 1) * N, BLOCK_COLS); bx++) {
+        bounds.far = std::min(bounds.far, block(bx, by).far);
+        bounds.near = std::max(bounds.near, block(bx, by).near);
+      }
+    }
+    tile(col, row) = bounds;
+  }
+};
@@ -1,9 +1,32 @@
 template <size_t D>
 using Color = std::array<uint8_t, D>;
 
-struct Shader {
-  virtual ~Shader() = default;
+// Shader `render` draws the model with, see shader.h.
+enum class Shading : uint32_t { Unlit, Lit, Depth };
 
-  virtual vec4f vertex(int iface, int nvert) = 0;
-  virtual bool fragment(vec3f bar, Color<3> color) = 0;
+// Triangles dropped at setup; front faces wind counter-clockwise on screen, as in OBJ files.
+enum class CullMode : uint32_t { None, Back, Front };
+
+// Pixel layouts of the bootloader framebuffer, see `bootloader_api::info::PixelFormat`.
+enum class PixelFormat : uint32_t { Rgb, Bgr, U8, Unknown };
+
+// Framebuffer handed over by the bootloader; rows are `stride` pixels apart, which may be more
+// than `width`.
+struct Display {
+  uint8_t *ptr;
+  size_t len;
+  size_t width;
+  size_t height;
+  size_t stride;
+  size_t bytes_per_pixel;
+  PixelFormat format;
+};
+
+// Lets a host other than the kernel drive `render`; every member may be null.
+struct RenderHooks {
+  void *ctx;
+  // overrides the camera of frame `frame`
+  void (*pose)(void *ctx, size_t frame, vec3f &eye, vec3f &center, vec3f &up);
+  // called once frame `frame` is on the display
+  void (*presented)(void *ctx, size_t frame);
 };
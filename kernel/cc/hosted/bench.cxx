@@ -0,0 +1,518 @@
+// Offline benchmark of the renderer: stands in for the kernel (model loading, cpus, clock), renders
+// the `kernel_main` camera path into memory and reports the frame time.
+//
+//   render_bench <mesh.obj> <texture.tga|ppm> [--frames N] [--warmup N] [--cpus N] [--orbit]
+//                [--shading lit|unlit|depth]
+//                [--record DIR | --compare DIR [--tolerance N] [--max-diff N] [--diff DIR]]
+//                [--only N]...
+//
+// `--orbit` circles the camera once around the mesh over the frames instead of following the
+// kernel path. Frame `n` always shows the same camera pose, so the frames double as golden images:
+// `--record` stores them as DIR/frame<n>.ppm and `--compare` fails when they no longer match;
+// `--only` limits both to the given frames. The references in hosted/golden are checked by ctest.
+// `--shading` picks the shader, unlit as in the kernel by default.
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "std/array"
+#include "matrix.h"
+#include "model.h"
+#include "gl.hxx"
+#include "bin.h"
+#include "hud.h"
+
+constexpr size_t WIDTH = 1280;
+constexpr size_t HEIGHT = 720;
+
+extern "C" void render(Display display, size_t frames, Shading shading, RenderHooks hooks);
+
+[[noreturn]] static void fail(const std::string &message) {
+  std::fprintf(stderr, "render_bench: %s\n", message.c_str());
+  std::exit(1);
+}
+
+static auto read_file(const std::string &path) -> std::vector<uint8_t> {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    fail("cannot open " + path);
+  }
+  return {std::istreambuf_iterator<char>(file), {}};
+}
+
+// Named apart from `Mesh` of vertex.h, which main.cxx defines differently.
+struct ObjMesh {
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+};
+
+// Same conversion as `bake_meshes` in kernel/build.rs: faces are fanned into triangles and corners
+// sharing both position and uv become one vertex.
+static auto load_obj(const std::string &path) -> ObjMesh {
+  std::ifstream file(path);
+  if (!file) {
+    fail("cannot open " + path);
+  }
+
+  std::vector<std::array<float_t, 3>> positions;
+  std::vector<std::array<float_t, 2>> uvs;
+  std::map<std::array<float_t, 5>, uint32_t> unique;
+  ObjMesh mesh;
+
+  // OBJ indices start at 1, negative ones count from the end
+  auto resolve = [](long idx, size_t len) { return idx < 0 ? len + idx : size_t(idx - 1); };
+
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream words(line);
+    std::string kind;
+    words >> kind;
+    if (kind == "v") {
+      auto &p = positions.emplace_back();
+      words >> p[0] >> p[1] >> p[2];
+    } else if (kind == "vt") {
+      auto &uv = uvs.emplace_back();
+      words >> uv[0] >> uv[1];
+    } else if (kind == "f") {
+      std::vector<uint32_t> face;
+      for (std::string corner; words >> corner;) {
+        long p = 0, t = 0;
+        if (std::sscanf(corner.c_str(), "%ld/%ld", &p, &t) != 2) {
+          fail(path + ": face corner `" + corner + "` without uv");
+        }
+        auto [x, y, z] = positions.at(resolve(p, positions.size()));
+        auto [u, v] = uvs.at(resolve(t, uvs.size()));
+        auto [it, added] = unique.try_emplace({x, y, z, u, v}, uint32_t(mesh.vertices.size()));
+        if (added) {
+          mesh.vertices.push_back({.position = {x, y, z}, .uv = {u, v}});
+        }
+        face.push_back(it->second);
+      }
+      for (size_t i = 2; i < face.size(); i++) {
+        mesh.indices.insert(mesh.indices.end(), {face[0], face[i - 1], face[i]});
+      }
+    }
+  }
+  return mesh;
+}
+
+struct Image {
+  std::vector<uint8_t> rgb;
+  size_t width = 0;
+  size_t height = 0;
+};
+
+// Uncompressed or RLE truecolor TGA.
+static auto load_tga(const std::string &path) -> Image {
+  auto data = read_file(path);
+  if (data.size() < 18 || (data[2] != 2 && data[2] != 10) || (data[16] != 24 && data[16] != 32)) {
+    fail(path + ": not a truecolor TGA");
+  }
+
+  Image image;
+  image.width = data[12] | data[13] << 8;
+  image.height = data[14] | data[15] << 8;
+  image.rgb.resize(image.width * image.height * 3);
+
+  size_t bpp = data[16] / 8, pos = 18 + data[0], pixels = image.width * image.height;
+  auto next = [&]() -> const uint8_t * {
+    if (pos + bpp > data.size()) {
+      fail(path + ": truncated");
+    }
+    pos += bpp;
+    return &data[pos - bpp];
+  };
+  auto put = [&, i = size_t(0)](const uint8_t *bgr) mutable {
+    if (i < pixels) {
+      image.rgb[i * 3 + 0] = bgr[2];
+      image.rgb[i * 3 + 1] = bgr[1];
+      image.rgb[i * 3 + 2] = bgr[0];
+    }
+    i++;
+  };
+
+  for (size_t i = 0; i < pixels;) {
+    size_t run = 1;
+    bool repeat = false;
+    if (data[2] == 10) {
+      if (pos >= data.size()) {
+        fail(path + ": truncated");
+      }
+      run = (data[pos] & 0x7f) + 1;
+      repeat = data[pos++] & 0x80;
+    }
+    const uint8_t *px = repeat ? next() : nullptr;
+    for (size_t k = 0; k < run; k++, i++) {
+      put(repeat ? px : next());
+    }
+  }
+
+  // rows are stored bottom up unless bit 5 of the descriptor is set
+  if (!(data[17] & 0x20)) {
+    for (size_t y = 0; y < image.height / 2; y++) {
+      std::swap_ranges(&image.rgb[y * image.width * 3], &image.rgb[(y + 1) * image.width * 3],
+                       &image.rgb[(image.height - 1 - y) * image.width * 3]);
+    }
+  }
+  return image;
+}
+
+// Binary `P6` PPM with 8-bit channels.
+static auto load_ppm(const std::string &path) -> Image {
+  auto data = read_file(path);
+  std::string text(data.begin(), data.begin() + std::min<size_t>(data.size(), 64));
+  std::istringstream header(text);
+
+  std::string magic;
+  size_t max = 0;
+  Image image;
+  header >> magic >> image.width >> image.height >> max;
+  if (magic != "P6" || max != 255) {
+    fail(path + ": not an 8-bit binary PPM");
+  }
+  size_t pos = size_t(header.tellg()) + 1;
+  if (pos + image.width * image.height * 3 > data.size()) {
+    fail(path + ": truncated");
+  }
+  image.rgb.assign(data.begin() + pos, data.begin() + pos + image.width * image.height * 3);
+  return image;
+}
+
+static void save_ppm(const std::string &path, const uint8_t *rgb, size_t width, size_t height) {
+  std::ofstream file(path, std::ios::binary);
+  file << "P6\n" << width << ' ' << height << "\n255\n";
+  file.write(reinterpret_cast<const char *>(rgb), std::streamsize(width * height * 3));
+  if (!file) {
+    fail("cannot write " + path);
+  }
+}
+
+// A pixel differs when any of its channels is off by more than `tolerance`, a frame fails when
+// more than `max_diff` of them do.
+struct Golden {
+  std::string record;
+  std::string compare;
+  // where to write the failed frames with differing pixels in red over the dimmed reference
+  std::string diff;
+  int tolerance = 0;
+  size_t max_diff = 0;
+  // frames to record or compare, all of them when empty
+  std::vector<size_t> only;
+  size_t checked = 0;
+  size_t failed = 0;
+
+  void check(const std::vector<uint8_t> &screen, size_t frame) {
+    if (!only.empty() && std::find(only.begin(), only.end(), frame) == only.end()) {
+      return;
+    }
+    auto name = "/frame" + std::to_string(frame) + ".ppm";
+    if (!record.empty()) {
+      save_ppm(record + name, screen.data(), WIDTH, HEIGHT);
+    }
+    if (compare.empty()) {
+      return;
+    }
+
+    checked++;
+    auto golden = load_ppm(compare + name);
+    if (golden.width != WIDTH || golden.height != HEIGHT) {
+      fail(compare + name + ": not " + std::to_string(WIDTH) + "x" + std::to_string(HEIGHT));
+    }
+
+    std::vector<uint8_t> marked(screen.size());
+    size_t differ = 0;
+    int worst = 0;
+    for (size_t i = 0; i < screen.size(); i += 3) {
+      int delta = 0;
+      for (size_t c = 0; c < 3; c++) {
+        delta = std::max(delta, std::abs(int(screen[i + c]) - int(golden.rgb[i + c])));
+      }
+      worst = std::max(worst, delta);
+      if (delta > tolerance) {
+        differ++;
+        marked[i] = 255;
+      } else {
+        for (size_t c = 0; c < 3; c++) {
+          marked[i + c] = golden.rgb[i + c] / 4;
+        }
+      }
+    }
+
+    if (differ > max_diff) {
+      failed++;
+      std::printf("frame %zu: %zu pixels differ, by up to %d\n", frame, differ, worst);
+      if (!diff.empty()) {
+        save_ppm(diff + name, marked.data(), WIDTH, HEIGHT);
+      }
+    }
+  }
+};
+
+static ObjMesh mesh;
+static Image texture;
+
+extern "C" ObjRepr load_elemental() {
+  return {
+      .vertices = mesh.vertices.data(),
+      .vertices_len = mesh.vertices.size(),
+      .indices = mesh.indices.data(),
+      .indices_len = mesh.indices.size(),
+      .texture = {texture.rgb.data(), texture.rgb.size(), texture.width, texture.height},
+  };
+}
+
+extern "C" uint64_t cpu_time_us() {
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+// no font on the host: the overlay stays off and cannot disturb golden images
+extern "C" GlyphAtlas glyph_atlas() {
+  return {};
+}
+
+// the serial console of the kernel
+extern "C" void serial_puts(const char *str) {
+  std::fprintf(stderr, "%s\n", str);
+}
+
+// Worker threads standing in for the application processors of `kernel/src/smp.rs`.
+struct Cpus {
+  std::mutex mutex;
+  std::condition_variable started, finished;
+  void (*job)(void *ctx, uint32_t cpu) = nullptr;
+  void *ctx = nullptr;
+  size_t generation = 0;
+  size_t running = 0;
+  bool stop = false;
+  std::vector<std::thread> workers;
+
+  ~Cpus() {
+    {
+      std::lock_guard lock(mutex);
+      stop = true;
+    }
+    started.notify_all();
+    for (auto &it : workers) {
+      it.join();
+    }
+  }
+
+  void start(size_t count) {
+    for (uint32_t cpu = 1; cpu < count; cpu++) {
+      workers.emplace_back([this, cpu] { work(cpu); });
+    }
+  }
+
+  void run(void (*job)(void *ctx, uint32_t cpu), void *ctx) {
+    {
+      std::lock_guard lock(mutex);
+      this->job = job;
+      this->ctx = ctx;
+      running = workers.size();
+      generation++;
+    }
+    started.notify_all();
+    job(ctx, 0);
+
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [&] { return running == 0; });
+  }
+
+ private:
+  void work(uint32_t cpu) {
+    size_t seen = 0;
+    while (true) {
+      std::unique_lock lock(mutex);
+      started.wait(lock, [&] { return stop || generation != seen; });
+      if (stop) {
+        return;
+      }
+      seen = generation;
+      auto [job, ctx] = std::pair(this->job, this->ctx);
+      lock.unlock();
+
+      job(ctx, cpu);
+
+      lock.lock();
+      if (--running == 0) {
+        finished.notify_one();
+      }
+    }
+  }
+};
+
+static Cpus cpus;
+
+extern "C" void smp_run(void (*job)(void *ctx, uint32_t cpu), void *ctx) {
+  cpus.run(job, ctx);
+}
+
+struct Bench {
+  size_t frames = 100;
+  size_t warmup = 1;
+  std::vector<uint8_t> screen = std::vector<uint8_t>(WIDTH * HEIGHT * 3);
+  bool orbit = false;
+  Shading shading = Shading::Unlit;
+  uint64_t last = 0;
+  std::vector<double> ms;
+  Golden golden;
+
+  // middle and half the diagonal of the bounding box of the mesh, the orbit is around them
+  vec3f middle;
+  float_t radius = 0;
+
+  // slightly from above, far enough for the whole bounding box to stay in view
+  static void pose(void *ctx, size_t frame, vec3f &eye, vec3f &center, vec3f &up) {
+    auto &self = *static_cast<Bench *>(ctx);
+    float_t angle = 2 * M_PI * float_t(frame) / float_t(self.frames);
+    center = self.middle;
+    eye = center + vec3f{std::sin(angle), 0.3, std::cos(angle)} * self.radius;
+    up = {0, 1, 0};
+  }
+
+  static void presented(void *ctx, size_t frame) {
+    auto &self = *static_cast<Bench *>(ctx);
+    self.ms.push_back(double(cpu_time_us() - self.last) / 1000);
+    self.golden.check(self.screen, frame);
+    self.last = cpu_time_us();
+  }
+
+  void run() {
+    Display display = {
+        .ptr = screen.data(),
+        .len = screen.size(),
+        .width = WIDTH,
+        .height = HEIGHT,
+        .stride = WIDTH,
+        .bytes_per_pixel = 3,
+        .format = PixelFormat::Rgb,
+    };
+    // once, outside of the timed frames
+    vec3f lo = mesh.vertices.front().position, hi = lo;
+    for (auto &it : mesh.vertices) {
+      for (size_t c = 0; c < 3; c++) {
+        lo[c] = std::min(lo[c], it.position[c]);
+        hi[c] = std::max(hi[c], it.position[c]);
+      }
+    }
+    middle = (lo + hi) / 2;
+    radius = (hi - lo).norm() / 2;
+
+    last = cpu_time_us();
+    render(display, frames, shading,
+           {.ctx = this, .pose = orbit ? pose : nullptr, .presented = presented});
+  }
+};
+
+int main(int argc, char **argv) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+  std::vector<std::string> paths;
+  Bench bench;
+  size_t count = std::max(1u, std::thread::hardware_concurrency());
+
+  for (size_t i = 0; i < args.size(); i++) {
+    auto number = [&] {
+      if (i + 1 == args.size()) {
+        fail(args[i] + " needs a value");
+      }
+      return size_t(std::stoul(args[++i]));
+    };
+    auto path = [&] {
+      if (i + 1 == args.size()) {
+        fail(args[i] + " needs a value");
+      }
+      return args[++i];
+    };
+    if (args[i] == "--frames") {
+      bench.frames = std::max<size_t>(number(), 1);
+    } else if (args[i] == "--warmup") {
+      bench.warmup = number();
+    } else if (args[i] == "--cpus") {
+      count = std::max<size_t>(number(), 1);
+    } else if (args[i] == "--orbit") {
+      bench.orbit = true;
+    } else if (args[i] == "--shading") {
+      auto name = path();
+      if (name == "lit") {
+        bench.shading = Shading::Lit;
+      } else if (name == "unlit") {
+        bench.shading = Shading::Unlit;
+      } else if (name == "depth") {
+        bench.shading = Shading::Depth;
+      } else {
+        fail("unknown shading " + name);
+      }
+    } else if (args[i] == "--record") {
+      bench.golden.record = path();
+    } else if (args[i] == "--compare") {
+      bench.golden.compare = path();
+    } else if (args[i] == "--diff") {
+      bench.golden.diff = path();
+    } else if (args[i] == "--tolerance") {
+      bench.golden.tolerance = int(number());
+    } else if (args[i] == "--max-diff") {
+      bench.golden.max_diff = number();
+    } else if (args[i] == "--only") {
+      bench.golden.only.push_back(number());
+    } else {
+      paths.push_back(args[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    fail("usage: render_bench <mesh.obj> <texture.tga|ppm> [--frames N] [--warmup N] [--cpus N]");
+  }
+
+  mesh = load_obj(paths[0]);
+  texture = paths[1].ends_with(".ppm") ? load_ppm(paths[1]) : load_tga(paths[1]);
+  cpus.start(count);
+
+  // the frame buffer lives on the stack of `render`, as it does on the kernel stack
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, 256 << 20);
+  pthread_t thread;
+  auto body = [](void *bench) -> void * {
+    static_cast<Bench *>(bench)->run();
+    return nullptr;
+  };
+  if (pthread_create(&thread, &attr, body, &bench) != 0) {
+    fail("cannot start the render thread");
+  }
+  pthread_join(thread, nullptr);
+
+  // the first frames also pay for setup and cold caches
+  std::vector<double> ms(bench.ms.begin() + std::min(bench.warmup, bench.ms.size() - 1),
+                         bench.ms.end());
+  double total = 0;
+  for (auto it : ms) {
+    total += it;
+  }
+  std::sort(ms.begin(), ms.end());
+
+  size_t triangles = mesh.indices.size() / 3;
+  std::printf("%zu triangles, %zu vertices, %zu cpus, %zu frames\n", triangles,
+              mesh.vertices.size(), count, ms.size());
+  std::printf("ms/frame: avg %.3f, min %.3f, median %.3f, max %.3f\n", total / ms.size(),
+              ms.front(), ms[ms.size() / 2], ms.back());
+  std::printf("triangles/sec: %.0f\n", double(triangles * ms.size()) / (total / 1000));
+
+  if (!bench.golden.compare.empty()) {
+    std::printf("golden: %zu of %zu frames differ\n", bench.golden.failed, bench.golden.checked);
+    return bench.golden.failed == 0 ? 0 : 1;
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "std/algorithm"
+#include "std/cstdint"
+#include "bin.h"
+#include "profile.h"
+
+extern "C" void *malloc(size_t);
+
+// Coverage of the glyphs of characters `first..first + count`, `width`x`height` bytes each.
+struct GlyphAtlas {
+  const uint8_t *coverage;
+  uint32_t first;
+  uint32_t count;
+  size_t width;
+  size_t height;
+};
+
+extern "C" GlyphAtlas glyph_atlas();
+
+// Dark text on a light panel in the top left corner. Glyphs are converted to the pixel format of
+// the target once, so a glyph costs a row copy per pixel row and the panel is a few thousand
+// pixels.
+struct Hud {
+  static constexpr size_t LINES = 4;
+  static constexpr int32_t MARGIN = 8;
+
+  GlyphAtlas atlas;
+  // `atlas.count` glyphs of `atlas.height` rows of `atlas.width` pixels
+  uint8_t *glyphs = nullptr;
+  size_t bytes_per_pixel = 0;
+  Line lines[LINES];
+
+  template <typename Frame>
+  Hud(GlyphAtlas atlas, const Frame &frame) : atlas(atlas), bytes_per_pixel(frame.bytes_per_pixel) {
+    auto cells = atlas.count * atlas.width * atlas.height;
+    glyphs = (uint8_t *)malloc(cells * bytes_per_pixel);
+    for (size_t i = 0; i < cells; i++) {
+      auto v = uint8_t(255 - atlas.coverage[i]);
+      frame.encode(glyphs + i * bytes_per_pixel, {v, v, v});
+    }
+  }
+
+  // Shows the statistics of the frame that is about to be presented.
+  template <typename Frame>
+  void draw(Frame &frame, uint64_t frame_us, uint32_t triangles, uint32_t rasterized) {
+    if (atlas.count == 0) {
+      return;
+    }
+
+    for (auto &it : lines) {
+      it = {};
+    }
+    lines[0] << "fps " << (frame_us ? 1000000 / frame_us : 0);
+    lines[1] << "frame " << frame_us / 1000 << "." << frame_us / 100 % 10 << " ms";
+    lines[2] << "tris " << uint64_t(rasterized) << " / " << uint64_t(triangles);
+    lines[3] << "pixels " << uint64_t(frame.shaded.load(std::memory_order_relaxed));
+
+    size_t columns = 0;
+    for (auto &it : lines) {
+      columns = std::max(columns, it.len);
+    }
+    auto panel = Rect{MARGIN, MARGIN, MARGIN + int32_t((columns + 2) * atlas.width) - 1,
+                      MARGIN + int32_t((LINES + 1) * atlas.height) - 1}
+                     .intersect(frame.screen);
+    if (panel.empty()) {
+      return;
+    }
+
+    // a space is a blank glyph, whose rows fill the panel background
+    for (int32_t y = panel.y0; y <= panel.y1; y++) {
+      for (int32_t x = panel.x0; x + int32_t(atlas.width) - 1 <= panel.x1; x += atlas.width) {
+        blit(frame, ' ', x, y, (y - panel.y0) % atlas.height);
+      }
+    }
+    for (size_t i = 0; i < LINES; i++) {
+      auto y = MARGIN + int32_t(atlas.height / 2 + i * atlas.height);
+      for (size_t c = 0; c < lines[i].len; c++) {
+        auto x = MARGIN + int32_t((c + 1) * atlas.width);
+        for (size_t row = 0; row < atlas.height; row++) {
+          if (x + int32_t(atlas.width) - 1 <= panel.x1 && y + int32_t(row) <= panel.y1) {
+            blit(frame, lines[i].text[c], x, y + row, row);
+          }
+        }
+      }
+    }
+    frame.drawn = frame.drawn.unite(panel);
+  }
+
+ private:
+  // Copies one pixel row of the glyph of `c`.
+  template <typename Frame>
+  void blit(Frame &frame, char c, int32_t x, int32_t y, size_t row) {
+    auto idx = uint32_t(uint8_t(c)) - atlas.first;
+    if (idx >= atlas.count) {
+      idx = '?' - atlas.first;
+    }
+    auto len = atlas.width * bytes_per_pixel;
+    std::copy_n(glyphs + (idx * atlas.height + row) * len, len,
+                frame.data() + y * frame.pitch + x * bytes_per_pixel);
+  }
+};
@@ -1,10 +1,20 @@
+#include "std/algorithm"
 #include "std/array"
+#include "std/atomic"
 #include "std/limits"
 #include "std/span"
 #include "matrix.h"
 #include "rand.h"
 #include "model.h"
 #include "gl.hxx"
+#include "bin.h"
+#include "clip.h"
+#include "depth.h"
+#include "swapchain.h"
+#include "vertex.h"
+#include "shader.h"
+#include "profile.h"
+#include "hud.h"
 
 template <size_t M>
 auto embed(const auto &v, float_t fill = 1) {
@@ -19,36 +29,129 @@ using std::uint32_t;
 using std::uint64_t;
 using std::uint8_t;
 
-constexpr size_t DESCALE_FACTOR = 1;
-constexpr size_t WIDTH = 1280 / DESCALE_FACTOR;
-constexpr size_t HEIGHT = 720 / DESCALE_FACTOR;
+constexpr size_t WIDTH = 1280;
+constexpr size_t HEIGHT = 720;
 constexpr size_t DEPTH = 255;
+constexpr size_t TILE = 64;
+constexpr size_t HIZ_BLOCK = 8;
+// initial size of the per-frame arena, which grows to what a frame needs
+constexpr size_t FRAME_ARENA = 1 << 20;
+// distance of the near plane from the eye
+constexpr float_t NEAR = 1e-2;
+// pixels around the screen where triangles may reach before they are clipped
+constexpr float_t GUARD_BAND = 8192;
 
 extern "C" void *malloc(size_t);
+// runs `job` on every online cpu, the calling one included, and waits for all of them
+extern "C" void smp_run(void (*job)(void *ctx, uint32_t cpu), void *ctx);
 
 template <typename T>
 constexpr T abs(T t) {
   return (t < 0) ? -t : t;
 }
 
-void barycentric(vec2f tr[3], vec2f P, vec3f &in_place) {
-  auto ABC = mat3x3({embed<3>(tr[0]), embed<3>(tr[1]), embed<3>(tr[2])});
-  if (ABC.det() < 1e-3) {
-    in_place = vec3f{-1, 1, 1};
-  } else {
-    in_place = ABC.invert_transpose() * embed<3>(P);
+// Screen positions are snapped to 1/16 of a pixel (28.4 fixed point) before rasterization, so
+// coverage is decided with exact integer math and shared edges agree bit for bit.
+constexpr int32_t SUBPIXEL_BITS = 4;
+constexpr int64_t SUBPIXEL = 1 << SUBPIXEL_BITS;
+// snapped coordinates stay below 2^26, so edge values stay far below 2^63; clipping to the guard
+// band keeps vertices well within it
+constexpr float_t SNAP_LIMIT = 1 << 22;
+
+struct Snapped {
+  int64_t x, y;
+
+  // rounds to the nearest 1/16 of a pixel
+  static auto snap(float_t v) -> int64_t {
+    v *= SUBPIXEL;
+    return int64_t(v < 0 ? v - 0.5f : v + 0.5f);
   }
-}
+};
+
+// Edge function of the directed edge (a, b), sampled at pixel centers: at P it equals twice the
+// signed area of (a, b, P) in 1/256 pixel units. It is affine in P, so stepping one pixel along x
+// or y is a single add of `dx` or `dy`. `sign` orients it to be positive inside the triangle.
+struct Edge {
+  int64_t dx, dy;
+  // value at the center of the pixel the edge was set up at, less `bias`
+  int64_t origin;
+  // taken off the value so that a plain sign test applies the top-left rule; added back to
+  // interpolate, where a covered pixel could otherwise have all three values at zero
+  int64_t bias = 0;
+
+  Edge(Snapped a, Snapped b, int64_t sign, int32_t x, int32_t y) {
+    int64_t nx = sign * (a.y - b.y), ny = sign * (b.x - a.x);
+    dx = nx * SUBPIXEL;
+    dy = ny * SUBPIXEL;
+    origin = nx * (x * SUBPIXEL + SUBPIXEL / 2 - a.x) + ny * (y * SUBPIXEL + SUBPIXEL / 2 - a.y);
+    // top-left rule: a pixel center exactly on the edge belongs to the triangle only if the edge is
+    // a left one (inside to its right) or a flat top one (inside below), so that of two triangles
+    // sharing the edge exactly one covers it
+    if (!(nx > 0 || (nx == 0 && ny > 0))) {
+      bias = 1;
+    }
+    origin -= bias;
+  }
+};
 
 template <size_t D>
 struct FrameBuffer : std::span<uint8_t> {
-  float_t z_buffer[HEIGHT * WIDTH] = {0};
+  // larger depth is nearer to the eye
+  float_t z_buffer[HEIGHT * WIDTH];
+  HiZ<WIDTH, HEIGHT, HIZ_BLOCK, TILE> hiz;
 
   mat4x4 camera;
   mat4x4 viewport;
   mat4x4 projection;
+  // projection * camera
+  mat4x4 mvp;
+
+  // pixels are written straight into the memory of the target
+  size_t pitch;
+  size_t bytes_per_pixel;
+  PixelFormat format;
+  // part of the `WIDTH`x`HEIGHT` target the display actually has
+  Rect screen;
+  // covers every pixel written since `before_update`, the rest of the target is left untouched
+  Rect drawn = Rect::nothing();
+  Clipper clipper;
+  // closed meshes never show their back faces
+  CullMode cull = CullMode::Back;
+
+  template <typename ShaderT>
+  struct Setup;
+
+  // memory that is only needed until the frame is presented, reset in `before_update`
+  Arena arena = Arena(FRAME_ARENA);
+  // `Setup`s of the triangles of the current draw, rasterized tile by tile in `flush`
+  void *setups = nullptr;
+  size_t setups_len = 0;
+  size_t setups_cap = 0;
+  // triangles set up by every draw since `before_update`
+  size_t accepted = 0;
+  using Bins = TileBins<WIDTH, HEIGHT, TILE>;
+  Bins bins;
+  // next tile to be taken by any of the cpus in `flush`
+  std::atomic<uint32_t> next_tile;
+  // pixels shaded and written since `before_update`
+  std::atomic<uint32_t> shaded;
 
-  explicit FrameBuffer(std::span<uint8_t> span) : std::span<uint8_t>(span) {}
+  explicit FrameBuffer(Display display) {
+    target(display);
+    std::fill_n(z_buffer, HEIGHT * WIDTH, std::numeric_limits<float_t>::lowest());
+    hiz.clear(std::numeric_limits<float_t>::lowest());
+  }
+
+  // Renders the next frames into another display or back buffer.
+  void target(Display display) {
+    static_cast<std::span<uint8_t> &>(*this) = {display.ptr, display.len};
+    pitch = display.stride * display.bytes_per_pixel;
+    bytes_per_pixel = display.bytes_per_pixel;
+    format = display.format;
+    screen = {0, 0, int32_t(std::min(display.width, WIDTH)) - 1,
+              int32_t(std::min(display.height, HEIGHT)) - 1};
+    clipper = Clipper(screen, NEAR, GUARD_BAND);
+  }
 
   void before_update(/* viewport   */ size_t x, size_t y, size_t w, size_t h,
                      /* lookat     */ vec3f eye, vec3f center, vec3f up,
@@ -87,130 +190,391 @@ struct FrameBuffer : std::span<uint8_t> {
       camera = minv * tr;
       // clang-format on
     }
+    mvp = projection * camera;
 
-    for (auto &it : z_buffer) {
-      it = std::numeric_limits<float_t>::max();
+    // depth was only written where the last frame drew
+    for (int32_t y = drawn.y0; y <= drawn.y1; y++) {
+      std::fill_n(z_buffer + y * WIDTH + drawn.x0, drawn.x1 - drawn.x0 + 1,
+                  std::numeric_limits<float_t>::lowest());
     }
+    hiz.clear(std::numeric_limits<float_t>::lowest());
+    drawn = Rect::nothing();
+    arena.reset();
+    accepted = 0;
+    shaded.store(0, std::memory_order_relaxed);
   }
 
   void set(size_t x, size_t y, Color<D> color) {
-    if (x > WIDTH || y > HEIGHT) {
-      return;
-    }
-    auto start = (y * WIDTH + x) * D;
-    if (start > this->size() || start + D > this->size()) {
-      return;
-    }
-    for (size_t i = 0; i < D; i++) {
-      (*this)[start + i] = color[i];
+    encode(this->data() + y * pitch + x * bytes_per_pixel, color);
+  }
+
+  // Stores a color as one pixel of the target.
+  void encode(uint8_t *px, Color<D> color) const {
+    // BT.601 luma in 8-bit fixed point
+    auto luma = [&] { return uint8_t((color[0] * 77 + color[1] * 150 + color[2] * 29) >> 8); };
+    switch (format) {
+      case PixelFormat::Rgb:
+        px[0] = color[0];
+        px[1] = color[1];
+        px[2] = color[2];
+        break;
+      case PixelFormat::Bgr:
+        px[0] = color[2];
+        px[1] = color[1];
+        px[2] = color[0];
+        break;
+      case PixelFormat::U8:
+        px[0] = luma();
+        break;
+      default:
+        // the channel layout is not known, but the pixel size is: gray in every byte of it is gray
+        // whatever the order, and never writes into the next pixel
+        std::fill_n(px, bytes_per_pixel, luma());
     }
   }
 
-  struct CoreShader {
-    mat2x3 uv = {};
+  // Per-triangle raster state, computed once when the triangle is submitted.
+  template <typename ShaderT>
+  struct Setup {
+    Rect bbox;
+    // edge values at the center of the top left pixel of `bbox`
+    Edge edges[3];
+    vec3f inv_w;
+    vec3f depth;
+    DepthBounds depth_bounds;
+    typename ShaderT::Varyings varyings[3];
+    uint32_t level;
+  };
 
-    auto vertex(const FrameBuffer<3> &frame, Triangle triangle, size_t nvert) -> vec4f {
-      uv.set_col(nvert, embed<2>(triangle.uv[nvert]));
-      return frame.projection * (frame.camera * embed<4>(triangle.vertices[nvert].position));
+  // Draws every triangle of `mesh` with `shader`, whose stages are inlined into the loops below.
+  template <typename ShaderT>
+  void draw(Mesh &mesh, const ShaderT &shader, Profiler &profiler) {
+    using S = Setup<ShaderT>;
+    // every vertex is transformed once, however many faces share it
+    auto clip = ClipCoords(mesh.positions.len, arena);
+    {
+      auto _ = profiler.scope(Profiler::Transform);
+      transform(mvp, mesh.positions, clip);
     }
 
-    auto fragment(Texture texture, vec3f bar, Color<3> &color) -> bool {
-      color = texture.diffuse(uv * bar);
-      return false;
+    {
+      auto _ = profiler.scope(Profiler::Setup);
+      // clipping splits the few triangles that cross the near plane or the guard band, `setup`
+      // grows the buffer when a close camera splits more
+      reserve<S>(mesh.indices_len / 3 * 2);
+      for (size_t i = 0; i + 3 <= mesh.indices_len; i += 3) {
+        vec4f verts[3];
+        typename ShaderT::Varyings varyings[3];
+        for (size_t k = 0; k < 3; k++) {
+          auto idx = mesh.indices[i + k];
+          verts[k] = clip.at(idx);
+          varyings[k] = shader.vertex(mesh, idx);
+        }
+        triangle(shader, verts, varyings);
+      }
+      accepted += setups_len;
     }
-  };
 
-  void triangle(vec4f verts[4], CoreShader shader, Texture texture) {
+    {
+      // binning, then rasterization and shading of every tile on every cpu
+      auto _ = profiler.scope(Profiler::Raster);
+      flush(shader);
+    }
+  }
+
+  template <typename S>
+  void reserve(size_t len) {
+    setups = arena.alloc<S>(len);
+    setups_len = 0;
+    setups_cap = len;
+  }
+
+  // Doubles the capacity of `setups`; the old buffer stays in the arena until the next frame.
+  template <typename S>
+  void grow() {
+    auto old = static_cast<S *>(setups);
+    setups_cap = std::max<size_t>(setups_cap * 2, 64);
+    setups = arena.alloc<S>(setups_cap);
+    std::copy_n(old, setups_len, static_cast<S *>(setups));
+  }
+
+  template <typename ShaderT>
+  void triangle(const ShaderT &shader, vec4f verts[3],
+                const typename ShaderT::Varyings (&varyings)[3]) {
     vec4f pts[3] = {viewport * verts[0], viewport * verts[1], viewport * verts[2]};
-    vec2f pts2[3] = {};
+    switch (clipper.classify(pts)) {
+      case Clipper::Reject:
+        break;
+      case Clipper::Accept:
+        setup(shader, pts, varyings);
+        break;
+      case Clipper::Split:
+        clipper.split(pts, [&](vec4f tri[3], const mat3x3 &bc) {
+          // varyings of the part are those of the whole at the barycentric weights of its vertices
+          typename ShaderT::Varyings part[3];
+          for (size_t k = 0; k < 3; k++) {
+            part[k] = interpolate(varyings, bc.col(k));
+          }
+          setup(shader, tri, part);
+        });
+        break;
+    }
+  }
+
+  // Queues a triangle given in homogeneous screen space for `flush`.
+  template <typename ShaderT>
+  void setup(const ShaderT &shader, vec4f pts[3],
+             const typename ShaderT::Varyings (&varyings)[3]) {
+    Snapped snapped[3];
     for (size_t i = 0; i < 3; i++) {
-      pts2[i] = embed<2>(pts[i] / pts[i][3]);
+      vec2f pt = embed<2>(pts[i] / pts[i][3]);
+      // clipping leaves only NaN from a degenerate camera here
+      if (!(abs(pt->x) < SNAP_LIMIT && abs(pt->y) < SNAP_LIMIT)) {
+        return;
+      }
+      snapped[i] = {Snapped::snap(pt->x), Snapped::snap(pt->y)};
     }
 
-    int32_t b_boxmin[2] = {WIDTH - 1, HEIGHT - 1};
-    int32_t b_boxmax[2] = {0, 0};
+    // pixels whose center lies within the snapped bounds
+    auto [x0, x1] = std::minmax({snapped[0].x, snapped[1].x, snapped[2].x});
+    auto [y0, y1] = std::minmax({snapped[0].y, snapped[1].y, snapped[2].y});
+    auto center = [](int64_t v) { return int32_t(v >> SUBPIXEL_BITS); };
+    auto bbox = Rect{center(x0 + SUBPIXEL / 2 - 1), center(y0 + SUBPIXEL / 2 - 1),
+                     center(x1 - SUBPIXEL / 2), center(y1 - SUBPIXEL / 2)}
+                    .intersect(screen);
 
-    for (auto &pt : pts2) {
-      for (size_t j = 0; j < 2; j++) {
-        b_boxmin[j] = std::min(b_boxmin[j], static_cast<int32_t>(pt[j]));
-        b_boxmax[j] = std::max(b_boxmax[j], static_cast<int32_t>(pt[j]));
+    // twice the signed screen area, positive for clockwise triangles since y points down
+    int64_t area = (snapped[1].y - snapped[2].y) * (snapped[0].x - snapped[1].x) +
+                   (snapped[2].x - snapped[1].x) * (snapped[0].y - snapped[1].y);
+    if (area == 0 || culled(area) || bbox.empty()) {
+      return;
+    }
+    if (setups_len == setups_cap) {
+      grow<Setup<ShaderT>>();
+    }
+    drawn = drawn.unite(bbox);
+
+    // edges opposite to each vertex, oriented to be positive inside the triangle whatever its
+    // winding, so that they are proportional to its barycentric weights
+    int64_t sign = area > 0 ? 1 : -1;
+    static_cast<Setup<ShaderT> *>(setups)[setups_len++] = {
+        .bbox = bbox,
+        .edges = {Edge(snapped[1], snapped[2], sign, bbox.x0, bbox.y0),
+                  Edge(snapped[2], snapped[0], sign, bbox.x0, bbox.y0),
+                  Edge(snapped[0], snapped[1], sign, bbox.x0, bbox.y0)},
+        .inv_w = {1 / pts[0][3], 1 / pts[1][3], 1 / pts[2][3]},
+        .depth = {pts[0][2], pts[1][2], pts[2][2]},
+        // interpolated depth is a convex combination of the vertex ones
+        .depth_bounds = {std::min({pts[0][2], pts[1][2], pts[2][2]}),
+                         std::max({pts[0][2], pts[1][2], pts[2][2]})},
+        .varyings = {varyings[0], varyings[1], varyings[2]},
+        .level = shader.level(varyings, float_t(area) / (SUBPIXEL * SUBPIXEL)),
+    };
+  }
+
+  [[nodiscard]] auto culled(int64_t area) const -> bool {
+    switch (cull) {
+      case CullMode::Back:
+        return area > 0;
+      case CullMode::Front:
+        return area < 0;
+      default:
+        return false;
+    }
+  }
+
+  // Rasterizes the triangles submitted since `before_update`, one screen tile at a time, so that
+  // color and depth writes of a tile stay in cache while all of its triangles are drawn. Tiles
+  // never share pixels, so every cpu takes the next free one until none are left.
+  template <typename ShaderT>
+  void flush(const ShaderT &shader) {
+    auto tris = static_cast<Setup<ShaderT> *>(setups);
+    bins.build(setups_len, [&](size_t i) { return tris[i].bbox; }, arena);
+
+    struct Job {
+      FrameBuffer &self;
+      Setup<ShaderT> *tris;
+      const ShaderT &shader;
+    } job = {*this, tris, shader};
+    next_tile.store(0, std::memory_order_relaxed);
+    smp_run(
+        [](void *ctx, uint32_t) {
+          auto &[self, tris, shader] = *static_cast<Job *>(ctx);
+          auto &next = self.next_tile;
+          for (uint32_t idx = next++; idx < Bins::COLS * Bins::ROWS; idx = next++) {
+            self.raster_tile(tris, shader, idx % Bins::COLS, idx / Bins::COLS);
+          }
+        },
+        &job);
+  }
+
+  template <typename ShaderT>
+  void raster_tile(Setup<ShaderT> *tris, const ShaderT &shader, size_t col, size_t row) {
+    auto tile = Bins::rect(col, row);
+    uint32_t written = 0;
+    for (auto i : bins.tile(col, row)) {
+      if (auto n = raster(tris[i], shader, col, row, tile)) {
+        hiz.refresh_tile(col, row);
+        written += n;
       }
     }
+    shaded.fetch_add(written, std::memory_order_relaxed);
+  }
+
+  // Rasterizes the part of a triangle inside a tile block by block, skipping blocks that it does
+  // not cover or where it is hidden behind everything already drawn. Returns how many pixels it
+  // wrote.
+  template <typename ShaderT>
+  auto raster(const Setup<ShaderT> &tri, const ShaderT &shader, size_t col, size_t row, Rect tile)
+      -> uint32_t {
+    if (tri.depth_bounds.near < hiz.tile(col, row).far) {
+      return 0;
+    }
+
+    auto [x0, y0, x1, y1] = tri.bbox.intersect(tile);
+    // signed like the pixel coordinates it divides
+    constexpr int32_t block = HIZ_BLOCK;
+    uint32_t written = 0;
+    for (int32_t by = y0 / block; by <= y1 / block; by++) {
+      for (int32_t bx = x0 / block; bx <= x1 / block; bx++) {
+        auto bounds = hiz.block(bx, by);
+        if (tri.depth_bounds.near < bounds.far) {
+          continue;
+        }
 
-    Color<3> color = {M_Random(), M_Random(), M_Random()};
-    for (int32_t x = std::max(b_boxmin[0], 0); x <= std::min(b_boxmax[0], int32_t(WIDTH - 1));
-         x++) {
-      for (int32_t y = std::max(b_boxmin[1], 0); y <= std::min(b_boxmax[1], int32_t(HEIGHT - 1));
-           y++) {
-        vec3f bc_screen = {};
-        barycentric(pts2, {static_cast<float_t>(x), static_cast<float_t>(y)}, bc_screen);
-        vec3f bc_clip = {bc_screen->x / pts[0][3], bc_screen->y / pts[1][3],
-                         bc_screen->z / pts[2][3]};
+        auto rect = Rect{bx * block, by * block, (bx + 1) * block - 1, (by + 1) * block - 1}
+                        .intersect({x0, y0, x1, y1});
+        std::array<int64_t, 3> row;
+        bool outside = false;
+        for (size_t i = 0; i < 3; i++) {
+          auto &edge = tri.edges[i];
+          row[i] = edge.origin + edge.dx * (rect.x0 - tri.bbox.x0) +
+                   edge.dy * (rect.y0 - tri.bbox.y0);
+          // edges are affine, so each one peaks at a corner of the block
+          int64_t peak = row[i] + std::max<int64_t>(edge.dx * (rect.x1 - rect.x0), 0) +
+                         std::max<int64_t>(edge.dy * (rect.y1 - rect.y0), 0);
+          outside |= peak < 0;
+        }
+        if (outside) {
+          continue;
+        }
+
+        // in front of every pixel of the block: the per-pixel test would always pass
+        bool test = tri.depth_bounds.far < bounds.near;
+        if (auto n = raster_block(tri, shader, rect, row, test)) {
+          hiz.refresh_block(z_buffer, bx, by);
+          written += n;
+        }
+      }
+    }
+    return written;
+  }
+
+  template <typename ShaderT>
+  auto raster_block(const Setup<ShaderT> &tri, const ShaderT &shader, Rect rect,
+                    std::array<int64_t, 3> row, bool depth_test) -> uint32_t {
+    auto [e0, e1, e2] = tri.edges;
+    uint32_t written = 0;
+    for (int32_t y = rect.y0; y <= rect.y1; y++) {
+      auto [w0, w1, w2] = row;
+      for (int32_t x = rect.x0; x <= rect.x1; x++, w0 += e0.dx, w1 += e1.dx, w2 += e2.dx) {
+        if ((w0 | w1 | w2) < 0) {
+          continue;
+        }
+        // edge values are the barycentric weights scaled by the area, which normalization drops;
+        // without the bias they sum to twice the area, never to zero
+        vec3f bc_screen = {float_t(w0 + e0.bias), float_t(w1 + e1.bias), float_t(w2 + e2.bias)};
+        vec3f bc_clip = {bc_screen->x * tri.inv_w->x, bc_screen->y * tri.inv_w->y,
+                         bc_screen->z * tri.inv_w->z};
         bc_clip = bc_clip / (bc_clip->x + bc_clip->y + bc_clip->z);
-        float_t frag_depth = vec3f{verts[0][2], verts[1][2], verts[2][2]}.dot(bc_clip);
-        if (bc_screen->x < 0 || bc_screen->y < 0 || bc_screen->z < 0
-            // || frag_depth > z_buffer[x + y * WIDTH]
-            ) {
+        float_t frag_depth = tri.depth.dot(bc_clip);
+        auto &depth = z_buffer[x + y * WIDTH];
+        if (depth_test && frag_depth < depth) {
           continue;
         }
-        Color<3> color = {M_Random(), M_Random(), M_Random()};
-        if (!shader.fragment(texture, bc_clip, color)) {
-          z_buffer[x + y * WIDTH] = frag_depth;
+        if constexpr (ShaderT::COLOR) {
+          Color<3> color;
+          if (shader.fragment(interpolate(tri.varyings, bc_clip), tri.level, color)) {
+            continue;
+          }
           this->set(x, y, color);
         }
+        depth = frag_depth;
+        written++;
       }
+      row = {row[0] + e0.dy, row[1] + e1.dy, row[2] + e2.dy};
     }
+    return written;
   }
 };
 
-constexpr size_t PLACE_LEN = WIDTH * HEIGHT * 3;
-
-extern "C" void kernel_main(uint8_t *buf, uint32_t len) {
-  vec3f light_dir{1, 1, 1};  // light source
-  vec3f eye{0, -1, 0};        // camera position
-  vec3f center{0, 0, 0};     // camera direction
-  vec3f up{0, 1, 0};         // camera up vector
-
-  auto place = (uint8_t *)malloc(PLACE_LEN);
-  auto frame = FrameBuffer<3>({place, PLACE_LEN});
+// Renders `frames` frames of `model` with `shader` into `display`, forever if it is 0, along the
+// demo camera path unless `hooks` provide the poses.
+template <typename ShaderT>
+static void render_frames(Display display, size_t frames, RenderHooks hooks, const ObjRepr &model,
+                          const ShaderT &shader) {
+  vec3f eye{0, -1, 0};     // camera position
+  vec3f center{0, 0, 0};  // camera direction
+  vec3f up{0, 1, 0};      // camera up vector
 
-  auto model = load_elemental();
-  while (true) {
-    frame.before_update( /* viewport */ WIDTH / 8, HEIGHT / 8, WIDTH * 3 / 4, HEIGHT * 3 / 4,
-                        /* camera   */ eye, center, up,
-                        /* projection */ 1.0 / (eye - center).norm());
-
-    for (int i = 0; i < PLACE_LEN; i++) {
-      place[i] = 255;
+  // nothing waits for vertical blank, so a third buffer would only add a frame of latency
+  auto chain = SwapChain<2>(display, WIDTH, HEIGHT, /* background */ 255);
+  auto frame = FrameBuffer<3>(chain.acquire());
+  auto mesh = Mesh(model);
+  Profiler profiler;
+  auto hud = Hud(glyph_atlas(), frame);
+  for (size_t n = 0; frames == 0 || n < frames; n++) {
+    profiler.begin_frame();
+    if (hooks.pose) {
+      hooks.pose(hooks.ctx, n, eye, center, up);
+    }
+    {
+      auto _ = profiler.scope(Profiler::Clear);
+      frame.target(chain.acquire());
+      frame.before_update( /* viewport */ WIDTH / 8, HEIGHT / 8, WIDTH * 3 / 4, HEIGHT * 3 / 4,
+                          /* camera   */ eye, center, up,
+                          /* projection */ 1.0 / (eye - center).norm());
     }
 
     // eye->x -= 0.1;
     eye->z -= 0.011;
     eye->y += 0.11;
 
-    for (size_t i = 0; i < model.triangles_len; i++) {
-      auto triangle = model.triangles[i];
+    frame.draw(mesh, shader, profiler);
 
-      FrameBuffer<3>::CoreShader shader = {};
-      vec4f verts[3];
-      for (int k = 0; k < 3; k++) {
-        verts[k] = shader.vertex(frame, triangle, k);
-      }
-      frame.triangle(verts, shader, model.texture);
-    }
-
-    for (size_t i = 0; i < WIDTH; i++) {
-      for (size_t j = 0; j < HEIGHT; j++) {
-        for (size_t k1 = 0; k1 < DESCALE_FACTOR; k1++) {
-          for (size_t k2 = 0; k2 < DESCALE_FACTOR; k2++) {
-            for (size_t c = 0; c < 3; c++) {
-              buf[((j * DESCALE_FACTOR + k1) * WIDTH * DESCALE_FACTOR + (i * DESCALE_FACTOR + k2)) *
-                      3 +
-                  c] = place[(j * WIDTH + i) * 3 + c];
-            }
-          }
-        }
-      }
+    {
+      auto _ = profiler.scope(Profiler::Overlay);
+      hud.draw(frame, profiler.last_frame_us(), mesh.indices_len / 3, frame.accepted);
+    }
+
+    {
+      auto _ = profiler.scope(Profiler::Present);
+      chain.present(frame.drawn);
+    }
+    profiler.end_frame();
+    if (hooks.presented) {
+      hooks.presented(hooks.ctx, n);
     }
   }
 }
+
+extern "C" void render(Display display, size_t frames, Shading shading, RenderHooks hooks) {
+  auto model = load_elemental();
+  auto texture = Mipmaps(model.texture);
+  auto sampler = Sampler{Address::Clamp, Filter::Bilinear};
+  switch (shading) {
+    case Shading::Lit: {
+      // light source
+      auto light = vec3f{1, 1, 1}.normalized();
+      return render_frames(display, frames, hooks, model, LitShader{texture, sampler, light});
+    }
+    case Shading::Depth:
+      return render_frames(display, frames, hooks, model, DepthShader{});
+    default:
+      return render_frames(display, frames, hooks, model, UnlitShader{texture, sampler});
+  }
+}
+
+extern "C" void kernel_main(Display display) {
+  render(display, 0, Shading::Unlit, {});
+}
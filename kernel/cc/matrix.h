@@ -1,5 +1,12 @@
 #include "types.h"
 
+// Fully unrolls the loop that follows, of at most 4 iterations; clang and GCC spell it differently.
+#if defined(__clang__)
+#define UNROLL _Pragma("unroll")
+#else
+#define UNROLL _Pragma("GCC unroll 4")
+#endif
+
 template <typename T, char iterations = 2>
 constexpr T inv_sqrt(T x) {
   using Repr = std::conditional_t<sizeof(T) == 8, std::int64_t, std::int32_t>;
@@ -270,11 +277,32 @@ struct matrix {
 
   template <size_t K>
   auto operator*(const matrix<T, C, K> &mat) const -> matrix<T, R, K> {
-    auto place = matrix<T, R, K>{};
+    if constexpr (R <= 4 && C <= 4 && K <= 4) {
+      // every column of the product is a sum of whole columns of `this`, fully unrolled into
+      // straight-line code that the compiler can keep a column per SIMD register for
+      matrix<T, R, K> place;
+      UNROLL
+      for (size_t k = 0; k < K; k++) {
+        UNROLL
+        for (size_t r = 0; r < R; r++) {
+          place.repr[k][r] = repr[0][r] * mat.repr[k][0];
+        }
+        UNROLL
+        for (size_t c = 1; c < C; c++) {
+          UNROLL
+          for (size_t r = 0; r < R; r++) {
+            place.repr[k][r] += repr[c][r] * mat.repr[k][c];
+          }
+        }
+      }
+      return place;
+    } else {
+      auto place = matrix<T, R, K>{};
 
-    gemm(R, C, K, true, this->repr_ptr(), this->strides(), mat.repr_ptr(), mat.strides(),
-         place.repr_ptr(), place.strides());
-    return place;
+      gemm(R, C, K, true, this->repr_ptr(), this->strides(), mat.repr_ptr(), mat.strides(),
+           place.repr_ptr(), place.strides());
+      return place;
+    }
   }
 
   auto operator/(T scalar) const -> matrix {
@@ -302,8 +330,74 @@ struct matrix {
   }
 
   auto invert_transpose() const -> matrix {
-    matrix ret = adjugate();
-    return ret / (ret.row(0).dot(row(0)));
+    if constexpr (R == C && R >= 2 && R <= 4) {
+      return inverse().transpose();
+    } else {
+      matrix ret = adjugate();
+      return ret / (ret.row(0).dot(row(0)));
+    }
+  }
+
+  // Closed form, without the recursive cofactor expansion; `det()` must not be zero.
+  auto inverse() const -> matrix
+    requires(R == C && R >= 2 && R <= 4)
+  {
+    const auto &a = *this;
+    matrix ret;
+    if constexpr (R == 2) {
+      ret = {a[1, 1], -a[0, 1], -a[1, 0], a[0, 0]};
+      return ret / det();
+    } else if constexpr (R == 3) {
+      // cofactors of a 3x3 matrix need no signs when rows and columns are taken cyclically
+      UNROLL
+      for (size_t i = 0; i < 3; i++) {
+        UNROLL
+        for (size_t j = 0; j < 3; j++) {
+          size_t r0 = (j + 1) % 3, r1 = (j + 2) % 3, c0 = (i + 1) % 3, c1 = (i + 2) % 3;
+          ret[i, j] = a[r0, c0] * a[r1, c1] - a[r0, c1] * a[r1, c0];
+        }
+      }
+      return ret / (a[0, 0] * ret[0, 0] + a[0, 1] * ret[1, 0] + a[0, 2] * ret[2, 0]);
+    } else {
+      // 2x2 determinants of the top two and the bottom two rows
+      T s0 = a[0, 0] * a[1, 1] - a[1, 0] * a[0, 1];
+      T s1 = a[0, 0] * a[1, 2] - a[1, 0] * a[0, 2];
+      T s2 = a[0, 0] * a[1, 3] - a[1, 0] * a[0, 3];
+      T s3 = a[0, 1] * a[1, 2] - a[1, 1] * a[0, 2];
+      T s4 = a[0, 1] * a[1, 3] - a[1, 1] * a[0, 3];
+      T s5 = a[0, 2] * a[1, 3] - a[1, 2] * a[0, 3];
+      T c5 = a[2, 2] * a[3, 3] - a[3, 2] * a[2, 3];
+      T c4 = a[2, 1] * a[3, 3] - a[3, 1] * a[2, 3];
+      T c3 = a[2, 1] * a[3, 2] - a[3, 1] * a[2, 2];
+      T c2 = a[2, 0] * a[3, 3] - a[3, 0] * a[2, 3];
+      T c1 = a[2, 0] * a[3, 2] - a[3, 0] * a[2, 2];
+      T c0 = a[2, 0] * a[3, 1] - a[3, 0] * a[2, 1];
+
+      // clang-format off
+      ret = {
+         a[1, 1] * c5 - a[1, 2] * c4 + a[1, 3] * c3,
+        -a[0, 1] * c5 + a[0, 2] * c4 - a[0, 3] * c3,
+         a[3, 1] * s5 - a[3, 2] * s4 + a[3, 3] * s3,
+        -a[2, 1] * s5 + a[2, 2] * s4 - a[2, 3] * s3,
+
+        -a[1, 0] * c5 + a[1, 2] * c2 - a[1, 3] * c1,
+         a[0, 0] * c5 - a[0, 2] * c2 + a[0, 3] * c1,
+        -a[3, 0] * s5 + a[3, 2] * s2 - a[3, 3] * s1,
+         a[2, 0] * s5 - a[2, 2] * s2 + a[2, 3] * s1,
+
+         a[1, 0] * c4 - a[1, 1] * c2 + a[1, 3] * c0,
+        -a[0, 0] * c4 + a[0, 1] * c2 - a[0, 3] * c0,
+         a[3, 0] * s4 - a[3, 1] * s2 + a[3, 3] * s0,
+        -a[2, 0] * s4 + a[2, 1] * s2 - a[2, 3] * s0,
+
+        -a[1, 0] * c3 + a[1, 1] * c1 - a[1, 2] * c0,
+         a[0, 0] * c3 - a[0, 1] * c1 + a[0, 2] * c0,
+        -a[3, 0] * s3 + a[3, 1] * s1 - a[3, 2] * s0,
+         a[2, 0] * s3 - a[2, 1] * s1 + a[2, 2] * s0,
+      };
+      // clang-format on
+      return ret / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+    }
   }
 
   auto adjugate() const -> matrix {
@@ -333,8 +427,28 @@ struct matrix {
   auto det() const -> T
     requires(R == C)
   {
+    const auto &a = *this;
     if constexpr (R == 1) {
-      return (*this)[0, 0];
+      return a[0, 0];
+    } else if constexpr (R == 2) {
+      return a[0, 0] * a[1, 1] - a[0, 1] * a[1, 0];
+    } else if constexpr (R == 3) {
+      return a[0, 0] * (a[1, 1] * a[2, 2] - a[1, 2] * a[2, 1]) -
+             a[0, 1] * (a[1, 0] * a[2, 2] - a[1, 2] * a[2, 0]) +
+             a[0, 2] * (a[1, 0] * a[2, 1] - a[1, 1] * a[2, 0]);
+    } else if constexpr (R == 4) {
+      T s0 = a[0, 0] * a[1, 1] - a[1, 0] * a[0, 1];
+      T s1 = a[0, 0] * a[1, 2] - a[1, 0] * a[0, 2];
+      T s2 = a[0, 0] * a[1, 3] - a[1, 0] * a[0, 3];
+      T s3 = a[0, 1] * a[1, 2] - a[1, 1] * a[0, 2];
+      T s4 = a[0, 1] * a[1, 3] - a[1, 1] * a[0, 3];
+      T s5 = a[0, 2] * a[1, 3] - a[1, 2] * a[0, 3];
+      return s0 * (a[2, 2] * a[3, 3] - a[3, 2] * a[2, 3]) -
+             s1 * (a[2, 1] * a[3, 3] - a[3, 1] * a[2, 3]) +
+             s2 * (a[2, 1] * a[3, 2] - a[3, 1] * a[2, 2]) +
+             s3 * (a[2, 0] * a[3, 3] - a[3, 0] * a[2, 3]) -
+             s4 * (a[2, 0] * a[3, 2] - a[3, 0] * a[2, 2]) +
+             s5 * (a[2, 0] * a[3, 1] - a[3, 0] * a[2, 1]);
     } else {
       T ret = 0;
       for (int i = R; i--;) {
@@ -2,23 +2,12 @@
 
 struct Vertex {
   vec3f position;
-};
-
-struct Triangle {
-  Vertex vertices[3];
-  vec3f uv[3];
+  vec2f uv;
 };
 
 using Rgb = std::array<uint8_t, 3>;
 
-constexpr float_t clamp1(float_t t) {
-  if (t >= 0.0 || t <= 1.0) {
-    return 1.0 - t;
-  } else {
-    return 0.0;
-  }
-}
-
+// Texture as it is loaded: rows of RGB texels.
 struct Texture {
   uint8_t *ptr;
   size_t len;
@@ -33,16 +22,203 @@ struct Texture {
         uint8_t(ptr[idx + 2]),
     };
   }
+};
+
+extern "C" void *malloc(size_t);
+
+// Texture stored as 4x4 tiles of 4 byte texels (RGB and padding): a tile is one 64 byte cache line,
+// so a fetch also brings in the neighbours of the texel along both axes, and the cache behaves the
+// same whichever way a triangle runs across the texture. Sizes are padded to whole tiles.
+struct TiledTexture {
+  static constexpr size_t TILE = 4;
+  static constexpr size_t LINE = 64;
+
+  uint8_t *texels;
+  size_t width;
+  size_t height;
+  // tiles per row
+  size_t cols;
+
+  TiledTexture() = default;
+
+  TiledTexture(size_t width, size_t height)
+      : width(width), height(height), cols((width + TILE - 1) / TILE) {
+    auto rows = (height + TILE - 1) / TILE;
+    // `malloc` only aligns to a word, tiles have to start on a line
+    auto raw = (uintptr_t)malloc(cols * rows * TILE * TILE * 4 + LINE - 1);
+    texels = (uint8_t *)((raw + LINE - 1) & ~(LINE - 1));
+  }
+
+  // Converts a texture to the tiled layout.
+  explicit TiledTexture(const Texture &src) : TiledTexture(src.width, src.height) {
+    for (size_t y = 0; y < height; y++) {
+      for (size_t x = 0; x < width; x++) {
+        set(x, y, src.get(x, y));
+      }
+    }
+  }
+
+  [[nodiscard]] auto get(size_t x, size_t y) const -> Rgb {
+    auto texel = texels + offset(x, y);
+    return {texel[0], texel[1], texel[2]};
+  }
+
+  // Texel at `column(x) + row(y)` with red in the low byte, in one aligned load.
+  [[nodiscard]] auto fetch(size_t offset) const -> uint32_t {
+    return *(const uint32_t *)(texels + offset);
+  }
+
+  // Parts of the offset of a texel that depend on its column and on its row only.
+  [[nodiscard]] static auto column(size_t x) -> size_t {
+    return (x / TILE * TILE * TILE + x % TILE) * 4;
+  }
+
+  [[nodiscard]] auto row(size_t y) const -> size_t {
+    return (y / TILE * cols * TILE * TILE + (y % TILE) * TILE) * 4;
+  }
+
+  void set(size_t x, size_t y, Rgb rgb) {
+    auto texel = texels + offset(x, y);
+    texel[0] = rgb[0];
+    texel[1] = rgb[1];
+    texel[2] = rgb[2];
+    texel[3] = 0;
+  }
+
+ private:
+  [[nodiscard]] auto offset(size_t x, size_t y) const -> size_t {
+    return column(x) + row(y);
+  }
+};
+
+// How texture coordinates outside of [0, 1] are brought back: repeating the texture or stretching
+// its border texels.
+enum class Address : uint32_t { Wrap, Clamp };
+// Nearest texel, or a blend of the four nearest texel centers.
+enum class Filter : uint32_t { Nearest, Bilinear };
+
+// Reads textures at (1 - u, 1 - v), in 24.8 fixed point once the coordinates are scaled to texels:
+// bilinear weights are the 8 fractional bits, and all channels are blended at once as 16-bit lanes
+// of one 64-bit integer, so a filtered sample is a few integer multiplies over nearest.
+struct Sampler {
+  Address address = Address::Clamp;
+  Filter filter = Filter::Nearest;
+
+  [[nodiscard]] auto sample(const TiledTexture &texture, vec2f uv) const -> Rgb {
+    int32_t w = int32_t(texture.width), h = int32_t(texture.height);
+    int32_t x = fixed(1 - uv->x, w), y = fixed(1 - uv->y, h);
+    uint32_t texel;
+    if (filter == Filter::Nearest) {
+      texel = texture.fetch(texture.column(wrap(x >> 8, w)) + texture.row(wrap(y >> 8, h)));
+    } else {
+      // weights are relative to texel centers
+      x -= 128;
+      y -= 128;
+      auto x0 = texture.column(wrap(x >> 8, w)), x1 = texture.column(wrap((x >> 8) + 1, w));
+      auto y0 = texture.row(wrap(y >> 8, h)), y1 = texture.row(wrap((y >> 8) + 1, h));
+      auto top = lerp(spread(texture.fetch(x0 + y0)), spread(texture.fetch(x1 + y0)), x & 255);
+      auto bottom = lerp(spread(texture.fetch(x0 + y1)), spread(texture.fetch(x1 + y1)), x & 255);
+      auto blend = lerp(top, bottom, y & 255);
+      texel = uint32_t(blend) | uint32_t(blend >> 24);
+    }
+    return {uint8_t(texel), uint8_t(texel >> 8), uint8_t(texel >> 16)};
+  }
+
+ private:
+  // `t` of a texture `size` texels long, in 1/256 of a texel
+  static auto fixed(float_t t, int32_t size) -> int32_t {
+    // clamped once scaled, whatever the size: far enough out to wrap any real coordinate, near
+    // enough for the texel center offset to stay within 32 bits
+    constexpr float_t LIMIT = 1 << 30;
+    float_t v = t * float_t(size * 256);
+    if (v != v) {
+      // NaN from a degenerate triangle, which converts to no integer
+      return 0;
+    }
+    return int32_t(std::min(std::max(v, -LIMIT), LIMIT));
+  }
+
+  [[nodiscard]] auto wrap(int32_t i, int32_t size) const -> size_t {
+    if (address == Address::Wrap) {
+      i %= size;
+      return i < 0 ? i + size : i;
+    }
+    return std::min(std::max(i, 0), size - 1);
+  }
+
+  // RGBX bytes to 16-bit lanes R, B, G, X
+  static auto spread(uint32_t texel) -> uint64_t {
+    return (texel & 0x00FF00FF) | (uint64_t(texel & 0xFF00FF00) << 24);
+  }
+
+  // (a * (256 - w) + b * w) / 256 rounded in every lane, which never carries into the next one
+  static auto lerp(uint64_t a, uint64_t b, int32_t w) -> uint64_t {
+    auto sum = a * uint64_t(256 - w) + b * uint64_t(w) + 0x0080008000800080;
+    return (sum >> 8) & 0x00FF00FF00FF00FF;
+  }
+};
+
+// Texture with its chain of mip levels, each half the size of the previous one down to a single
+// texel. A triangle samples the level whose texels are about as large as its pixels, so a distant
+// one reads a small, cache resident image instead of scattered texels of the full one.
+struct Mipmaps {
+  static constexpr size_t MAX_LEVELS = 16;
+
+  TiledTexture levels[MAX_LEVELS];
+  size_t len = 1;
+
+  explicit Mipmaps(const Texture &base) {
+    levels[0] = TiledTexture(base);
+    while (len < MAX_LEVELS && (levels[len - 1].width > 1 || levels[len - 1].height > 1)) {
+      levels[len] = downsample(levels[len - 1]);
+      len++;
+    }
+  }
+
+  // Level for a triangle that covers `uv_area` of the texture and `screen_area` pixels, both twice
+  // the area of either sign, rounded to the nearest level since texels shrink fourfold per level.
+  [[nodiscard]] auto level(float_t uv_area, float_t screen_area) const -> uint32_t {
+    float_t ratio = uv_area * float_t(levels[0].width * levels[0].height) / screen_area;
+    ratio = ratio < 0 ? -ratio : ratio;
+    uint32_t level = 0;
+    while (ratio >= 2 && level + 1 < len) {
+      ratio /= 4;
+      level++;
+    }
+    return level;
+  }
+
+  [[nodiscard]] auto sample(const Sampler &sampler, vec2f uv, uint32_t level) const -> Rgb {
+    return sampler.sample(levels[level], uv);
+  }
 
-  [[nodiscard]] auto diffuse(vec2f uv) const {
-    auto ui = vec2i(clamp1(uv->x) * float_t(width), clamp1(uv->y) * float_t(height));
-    return get(ui->x, ui->y);
+ private:
+  // Averages blocks of 2x2 texels, the last row or column of an odd size is averaged with itself.
+  static auto downsample(const TiledTexture &src) -> TiledTexture {
+    auto dst =
+        TiledTexture(std::max<size_t>(src.width / 2, 1), std::max<size_t>(src.height / 2, 1));
+    for (size_t y = 0; y < dst.height; y++) {
+      size_t y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+      for (size_t x = 0; x < dst.width; x++) {
+        size_t x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+        auto a = src.get(x0, y0), b = src.get(x1, y0), c = src.get(x0, y1), d = src.get(x1, y1);
+        Rgb avg;
+        for (size_t i = 0; i < 3; i++) {
+          avg[i] = uint8_t((a[i] + b[i] + c[i] + d[i] + 2) / 4);
+        }
+        dst.set(x, y, avg);
+      }
+    }
+    return dst;
   }
 };
 
+// Faces are `indices[3 * i..3 * i + 3]`, vertices shared between them are stored once.
 struct ObjRepr {
-  Triangle *triangles;
-  size_t triangles_len;
+  const Vertex *vertices;
+  size_t vertices_len;
+  const uint32_t *indices;
+  size_t indices_len;
   Texture texture;
 };
 
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "std/algorithm"
+#include "std/cstdint"
+
+extern "C" uint64_t cpu_time_us();
+// writes a line to the serial console
+extern "C" void serial_puts(const char *str);
+
+// Line of text built without printf, cut short if it does not fit.
+struct Line {
+  char text[160];
+  size_t len = 0;
+
+  auto operator<<(const char *str) -> Line & {
+    while (*str && len + 1 < sizeof(text)) {
+      text[len++] = *str++;
+    }
+    return *this;
+  }
+
+  auto operator<<(uint64_t n) -> Line & {
+    char digits[20];
+    size_t count = 0;
+    do {
+      digits[count++] = char('0' + n % 10);
+      n /= 10;
+    } while (n);
+    while (count && len + 1 < sizeof(text)) {
+      text[len++] = digits[--count];
+    }
+    return *this;
+  }
+
+  auto c_str() -> const char * {
+    text[len] = 0;
+    return text;
+  }
+};
+
+// Time spent in each stage of the last `WINDOW` frames, logged as min/avg/p99 every `WINDOW`
+// frames.
+struct Profiler {
+  enum Stage : size_t { Clear, Transform, Setup, Raster, Overlay, Present, STAGES };
+
+  static constexpr size_t WINDOW = 128;
+  static constexpr const char *NAMES[STAGES + 1] = {"clear", "transform", "setup",  "raster",
+                                                    "hud",   "present",   "frame"};
+
+  // microseconds, the last row is the whole frame
+  uint32_t samples[STAGES + 1][WINDOW] = {};
+  uint64_t current[STAGES] = {};
+  uint64_t frame_start = 0;
+  size_t frames = 0;
+
+  // Adds the time until it goes out of scope to a stage.
+  struct Scope {
+    Profiler &profiler;
+    Stage stage;
+    uint64_t start;
+
+    ~Scope() {
+      profiler.current[stage] += cpu_time_us() - start;
+    }
+  };
+
+  [[nodiscard]] auto scope(Stage stage) -> Scope {
+    return {*this, stage, cpu_time_us()};
+  }
+
+  [[nodiscard]] auto last_frame_us() const -> uint64_t {
+    return frames ? samples[STAGES][(frames - 1) % WINDOW] : 0;
+  }
+
+  void begin_frame() {
+    std::fill_n(current, STAGES, 0);
+    frame_start = cpu_time_us();
+  }
+
+  void end_frame() {
+    auto slot = frames % WINDOW;
+    for (size_t i = 0; i < STAGES; i++) {
+      samples[i][slot] = uint32_t(current[i]);
+    }
+    samples[STAGES][slot] = uint32_t(cpu_time_us() - frame_start);
+
+    if (++frames % WINDOW == 0) {
+      report();
+    }
+  }
+
+ private:
+  void report() {
+    for (size_t i = 0; i <= STAGES; i++) {
+      uint32_t sorted[WINDOW];
+      std::copy_n(samples[i], WINDOW, sorted);
+      std::sort(sorted, sorted + WINDOW);
+
+      uint64_t total = 0;
+      for (auto it : sorted) {
+        total += it;
+      }
+
+      Line line;
+      line << "profile " << NAMES[i] << ": min " << uint64_t(sorted[0]) << "us avg "
+           << total / WINDOW << "us p99 " << uint64_t(sorted[WINDOW * 99 / 100]) << "us";
+      serial_puts(line.c_str());
+    }
+  }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "types.h"
+
+// Shaders are plain structs that `FrameBuffer::draw` is instantiated with, so both of their stages
+// are inlined into its loops:
+//
+// - `Varyings`: what `vertex` outputs per vertex and `fragment` receives interpolated per pixel,
+//   any type with `+` and `*` by a weight;
+// - `vertex(mesh, idx)`: varyings of vertex `idx` of `mesh`;
+// - `level(v, area)`: mip level of a triangle with vertex varyings `v` and twice `area` pixels;
+// - `fragment(in, level, color)`: stores the color of a pixel, returns true to discard it;
+// - `COLOR`: false when only depth is written, then `fragment` is never called.
+
+// Varyings at the barycentric weights `bc` of a triangle with vertex varyings `v`.
+template <typename V>
+auto interpolate(const V (&v)[3], vec3f bc) -> V {
+  return v[0] * bc->x + v[1] * bc->y + v[2] * bc->z;
+}
+
+// Twice the signed area of a triangle in texture space.
+inline auto uv_area(vec2f a, vec2f b, vec2f c) -> float_t {
+  return (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+}
+
+// Texture as it is, without lighting.
+struct UnlitShader {
+  static constexpr bool COLOR = true;
+
+  using Varyings = vec2f;
+
+  const Mipmaps &texture;
+  Sampler sampler;
+
+  [[nodiscard]] auto vertex(const Mesh &mesh, uint32_t idx) const -> Varyings {
+    return mesh.vertices[idx].uv;
+  }
+
+  [[nodiscard]] auto level(const Varyings (&v)[3], float_t area) const -> uint32_t {
+    return texture.level(uv_area(v[0], v[1], v[2]), area);
+  }
+
+  auto fragment(const Varyings &uv, uint32_t level, Color<3> &color) const -> bool {
+    color = texture.sample(sampler, uv, level);
+    return false;
+  }
+};
+
+// Texture lit by a directional light with Lambert's law over smooth vertex normals.
+struct LitShader {
+  static constexpr bool COLOR = true;
+  // share of the light that reaches faces turned away from the light
+  static constexpr float_t AMBIENT = 0.25;
+
+  struct Varyings {
+    vec2f uv;
+    vec3f normal;
+
+    auto operator+(const Varyings &other) const -> Varyings {
+      return {uv + other.uv, normal + other.normal};
+    }
+
+    auto operator*(float_t weight) const -> Varyings {
+      return {uv * weight, normal * weight};
+    }
+  };
+
+  const Mipmaps &texture;
+  Sampler sampler;
+  // unit vector towards the light, in model space
+  vec3f light;
+
+  [[nodiscard]] auto vertex(const Mesh &mesh, uint32_t idx) const -> Varyings {
+    return {mesh.vertices[idx].uv, mesh.normals.at(idx)};
+  }
+
+  [[nodiscard]] auto level(const Varyings (&v)[3], float_t area) const -> uint32_t {
+    return texture.level(uv_area(v[0].uv, v[1].uv, v[2].uv), area);
+  }
+
+  auto fragment(const Varyings &in, uint32_t level, Color<3> &color) const -> bool {
+    float_t diffuse = std::max<float_t>(in.normal.normalized().dot(light), 0);
+    float_t intensity = AMBIENT + (1 - AMBIENT) * diffuse;
+    color = texture.sample(sampler, in.uv, level);
+    for (auto &it : color) {
+      it = uint8_t(float_t(it) * intensity);
+    }
+    return false;
+  }
+};
+
+// Writes depth only, as a depth pre-pass or to time rasterization without shading.
+struct DepthShader {
+  static constexpr bool COLOR = false;
+
+  struct Varyings {
+    auto operator+(const Varyings &) const -> Varyings {
+      return {};
+    }
+
+    auto operator*(float_t) const -> Varyings {
+      return {};
+    }
+  };
+
+  [[nodiscard]] auto vertex(const Mesh &, uint32_t) const -> Varyings {
+    return {};
+  }
+
+  [[nodiscard]] auto level(const Varyings (&)[3], float_t) const -> uint32_t {
+    return 0;
+  }
+
+  auto fragment(const Varyings &, uint32_t, Color<3> &) const -> bool {
+    return false;
+  }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "std/algorithm"
+#include "bin.h"
+
+extern "C" void *malloc(size_t);
+
+// `N` back buffers in the pixel format of the display, presented by copying only the rows and
+// columns that changed. A back buffer comes around again every `N` frames still holding what was
+// drawn into it then, so only that part is cleared before it is reused, and the display only needs
+// what is drawn now plus what the previous frame drew over the background.
+template <size_t N>
+struct SwapChain {
+  static_assert(N > 0);
+
+  struct Buffer {
+    uint8_t *pixels;
+    // everything else is background
+    Rect drawn;
+  };
+
+  Display display;
+  // back buffers cover the `width`x`height` top left corner of the display
+  size_t width;
+  size_t height;
+  uint8_t background;
+  Buffer buffers[N];
+  size_t current = 0;
+  // drawn over the background on the display
+  Rect shown = Rect::nothing();
+
+  SwapChain(Display display, size_t width, size_t height, uint8_t background)
+      : display(display),
+        width(std::min(width, display.width)),
+        height(std::min(height, display.height)),
+        background(background) {
+    for (auto &buffer : buffers) {
+      buffer.pixels = (uint8_t *)malloc(this->width * this->height * display.bytes_per_pixel);
+      buffer.drawn = Rect::nothing();
+      std::fill_n(buffer.pixels, this->width * this->height * display.bytes_per_pixel, background);
+    }
+    for (size_t y = 0; y < display.height; y++) {
+      std::fill_n(display.ptr + y * display.stride * display.bytes_per_pixel,
+                  display.width * display.bytes_per_pixel, background);
+    }
+  }
+
+  // Clears the back buffer for the next frame and describes it as a display to render into.
+  auto acquire() -> Display {
+    auto &back = buffers[current];
+    fill(back.pixels, width, back.drawn, background);
+    back.drawn = Rect::nothing();
+
+    return {
+        .ptr = back.pixels,
+        .len = width * height * display.bytes_per_pixel,
+        .width = width,
+        .height = height,
+        .stride = width,
+        .bytes_per_pixel = display.bytes_per_pixel,
+        .format = display.format,
+    };
+  }
+
+  // Shows the acquired back buffer, in which nothing outside `drawn` was touched.
+  void present(Rect drawn) {
+    auto &back = buffers[current];
+    auto bpp = display.bytes_per_pixel;
+
+    auto dirty = drawn.unite(shown);
+    for (int32_t y = dirty.y0; y <= dirty.y1; y++) {
+      std::copy_n(back.pixels + (y * width + dirty.x0) * bpp, (dirty.x1 - dirty.x0 + 1) * bpp,
+                  display.ptr + (y * display.stride + dirty.x0) * bpp);
+    }
+
+    back.drawn = drawn;
+    shown = drawn;
+    current = (current + 1) % N;
+  }
+
+ private:
+  void fill(uint8_t *pixels, size_t stride, Rect rect, uint8_t value) {
+    auto bpp = display.bytes_per_pixel;
+    for (int32_t y = rect.y0; y <= rect.y1; y++) {
+      std::fill_n(pixels + (y * stride + rect.x0) * bpp, (rect.x1 - rect.x0 + 1) * bpp, value);
+    }
+  }
+};
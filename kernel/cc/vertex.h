@@ -0,0 +1,92 @@
+#pragma once
+
+#include "types.h"
+#include "arena.h"
+
+// `N` components of `len` vertices in structure-of-arrays layout, one array per component, so that
+// a stage over them is one long loop of the same few operations.
+template <size_t N>
+struct VertexArrays {
+  float_t *component[N];
+  size_t len;
+
+  explicit VertexArrays(size_t len) : len(len) {
+    for (auto &it : component) {
+      it = (float_t *)malloc(len * sizeof(float_t));
+    }
+  }
+
+  // Arrays that last until `arena` is reset.
+  VertexArrays(size_t len, Arena &arena) : len(len) {
+    for (auto &it : component) {
+      it = arena.alloc<float_t>(len);
+    }
+  }
+
+  [[nodiscard]] auto at(size_t idx) const -> vector<float_t, N> {
+    vector<float_t, N> ret;
+    for (size_t i = 0; i < N; i++) {
+      ret[i] = component[i][idx];
+    }
+    return ret;
+  }
+};
+
+using Positions = VertexArrays<3>;
+using ClipCoords = VertexArrays<4>;
+
+// Transforms every position into clip space at once; `out` must be at least as long as `in`.
+inline void transform(const mat4x4 &mvp, const Positions &in, ClipCoords &out) {
+  const float_t *__restrict x = in.component[0];
+  const float_t *__restrict y = in.component[1];
+  const float_t *__restrict z = in.component[2];
+
+  for (size_t row = 0; row < 4; row++) {
+    float_t *__restrict dst = out.component[row];
+    float_t mx = mvp[row, 0], my = mvp[row, 1], mz = mvp[row, 2], mw = mvp[row, 3];
+    for (size_t i = 0; i < in.len; i++) {
+      dst[i] = mx * x[i] + my * y[i] + mz * z[i] + mw;
+    }
+  }
+}
+
+// Model ready to be drawn: its positions in structure-of-arrays layout and smooth vertex normals.
+struct Mesh {
+  const Vertex *vertices;
+  const uint32_t *indices;
+  size_t indices_len;
+  Positions positions;
+  VertexArrays<3> normals;
+
+  explicit Mesh(const ObjRepr &model)
+      : vertices(model.vertices),
+        indices(model.indices),
+        indices_len(model.indices_len),
+        positions(model.vertices_len),
+        normals(model.vertices_len) {
+    for (size_t i = 0; i < model.vertices_len; i++) {
+      for (size_t c = 0; c < 3; c++) {
+        positions.component[c][i] = vertices[i].position[c];
+        normals.component[c][i] = 0;
+      }
+    }
+
+    // sum of the normals of the faces around each vertex, weighted by their area
+    for (size_t i = 0; i + 3 <= indices_len; i += 3) {
+      auto a = vertices[indices[i]].position, b = vertices[indices[i + 1]].position,
+           c = vertices[indices[i + 2]].position;
+      vec3f normal = (b - a).cross(c - a);
+      for (size_t k = 0; k < 3; k++) {
+        for (size_t j = 0; j < 3; j++) {
+          normals.component[j][indices[i + k]] += normal[j];
+        }
+      }
+    }
+    for (size_t i = 0; i < model.vertices_len; i++) {
+      float_t norm = normals.at(i).norm();
+      for (size_t c = 0; c < 3 && norm > 0; c++) {
+        normals.component[c][i] /= norm;
+      }
+    }
+  }
+};
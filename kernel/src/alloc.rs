@@ -1,40 +1,151 @@
 use {
+    bootloader_api::info::{MemoryRegion, MemoryRegionKind},
     core::{
         alloc::{GlobalAlloc, Layout},
-        mem::{self, MaybeUninit},
+        mem, ptr,
+        sync::atomic::{AtomicUsize, Ordering},
     },
     linked_list_allocator::LockedHeap,
+    spin::Mutex,
 };
 
+/// Size and alignment of the chunks large buffers are made of, one huge page
+pub const CHUNK: usize = 2 * 1024 * 1024;
+/// Below it are the real mode IVT, the BIOS and the SMP trampoline with its page tables
+const LOW_MEMORY_END: u64 = 0x10_0000;
+const MAX_SPANS: usize = 64;
+
 #[global_allocator]
-pub static mut ALLOC: StaticAlloc<{ 8 * 1024 * 1024 }> = unsafe { StaticAlloc::new() };
+pub static ALLOC: RegionAlloc = RegionAlloc::new();
+
+/// Free run of whole chunks, as a range of virtual addresses
+#[derive(Clone, Copy)]
+struct Span {
+    start: usize,
+    end: usize,
+}
+
+/// Usable memory of the bootloader memory map cut into chunks: a buffer of a chunk or more gets
+/// whole chunks of one run, first fit, and freed ones are merged back with their neighbours.
+struct Chunks {
+    spans: [Span; MAX_SPANS],
+    len: usize,
+}
+
+impl Chunks {
+    fn push(&mut self, span: Span) {
+        // the runs of a full table are lost rather than tracked, there are few of them
+        if span.start < span.end && self.len < MAX_SPANS {
+            self.spans[self.len] = span;
+            self.len += 1;
+        }
+    }
+
+    fn largest(&self) -> usize {
+        self.spans[..self.len].iter().map(|s| s.end - s.start).max().unwrap_or(0)
+    }
+
+    fn alloc(&mut self, size: usize) -> *mut u8 {
+        let Some(span) = self.spans[..self.len].iter_mut().find(|s| s.end - s.start >= size) else {
+            return ptr::null_mut();
+        };
+        let start = span.start;
+        span.start += size;
+        start as *mut u8
+    }
 
-pub struct StaticAlloc<const N: usize> {
-    heap: [MaybeUninit<u8>; N],
-    alloc: LockedHeap,
+    fn dealloc(&mut self, start: usize, size: usize) {
+        let end = start + size;
+        let spans = &mut self.spans[..self.len];
+        let prev = spans.iter().position(|s| s.end == start);
+        let next = spans.iter().position(|s| s.start == end);
+        match (prev, next) {
+            (Some(prev), Some(next)) => {
+                self.spans[prev].end = self.spans[next].end;
+                self.len -= 1;
+                self.spans[next] = self.spans[self.len];
+            }
+            (Some(prev), None) => self.spans[prev].end = end,
+            (None, Some(next)) => self.spans[next].start = start,
+            (None, None) => self.push(Span { start, end }),
+        }
+    }
+}
+
+/// Heap over the usable regions that the bootloader reports: buffers of at least a chunk take
+/// 2 MiB aligned chunks, which also keeps them on huge pages of the physical memory mapping, and
+/// smaller allocations share a linked list heap carved out of the chunks once at `init`.
+pub struct RegionAlloc {
+    chunks: Mutex<Chunks>,
+    small: LockedHeap,
+    size: AtomicUsize,
 }
 
-impl<const N: usize> StaticAlloc<N> {
-    pub const unsafe fn new() -> Self {
-        Self { heap: [MaybeUninit::uninit(); N], alloc: LockedHeap::empty() }
+impl RegionAlloc {
+    pub const fn new() -> Self {
+        Self {
+            chunks: Mutex::new(Chunks { spans: [Span { start: 0, end: 0 }; MAX_SPANS], len: 0 }),
+            small: LockedHeap::empty(),
+            size: AtomicUsize::new(0),
+        }
     }
 
-    pub fn init(&'static mut self) {
-        // static values cannot change your place
-        self.alloc.lock().init_from_slice(&mut self.heap);
+    /// Claims usable `regions` above low memory, reached at `phys` + their physical address.
+    ///
+    /// # Safety
+    /// Must be called once, before anything is allocated, and `regions` must not be in use.
+    pub unsafe fn init(&self, phys: u64, regions: &[MemoryRegion]) {
+        let mut chunks = self.chunks.lock();
+        for region in regions.iter().filter(|r| r.kind == MemoryRegionKind::Usable) {
+            let start = (phys + region.start.max(LOW_MEMORY_END)) as usize;
+            let end = (phys + region.end) as usize;
+            if start < end {
+                chunks.push(Span { start: align_up(start, CHUNK), end: end & !(CHUNK - 1) });
+            }
+        }
+
+        let total: usize = chunks.spans[..chunks.len].iter().map(|s| s.end - s.start).sum();
+        self.size.store(total, Ordering::Relaxed);
+
+        // an eighth goes to small allocations, they are mostly bookkeeping of the large ones
+        let small = (total / 8).max(CHUNK).min(chunks.largest()) & !(CHUNK - 1);
+        let heap = chunks.alloc(small);
+        assert!(!heap.is_null(), "no usable memory above 1 MiB");
+        self.small.lock().init(heap, small);
+    }
+
+    /// Bytes of memory claimed at `init`.
+    pub fn size(&self) -> usize {
+        self.size.load(Ordering::Relaxed)
+    }
+
+    fn is_large(layout: Layout) -> bool {
+        layout.size() >= CHUNK && layout.align() <= CHUNK
     }
 }
 
-unsafe impl<const N: usize> GlobalAlloc for StaticAlloc<N> {
+unsafe impl GlobalAlloc for RegionAlloc {
     unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
-        self.alloc.alloc(layout)
+        if Self::is_large(layout) {
+            self.chunks.lock().alloc(align_up(layout.size(), CHUNK))
+        } else {
+            self.small.alloc(layout)
+        }
     }
 
     unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
-        self.alloc.dealloc(ptr, layout)
+        if Self::is_large(layout) {
+            self.chunks.lock().dealloc(ptr as usize, align_up(layout.size(), CHUNK))
+        } else {
+            self.small.dealloc(ptr, layout)
+        }
     }
 }
 
+fn align_up(addr: usize, align: usize) -> usize {
+    (addr + align - 1) & !(align - 1)
+}
+
 #[no_mangle]
 unsafe extern "C" fn malloc(size: usize) -> *mut u8 {
     ALLOC.alloc(Layout::from_size_align(size, mem::align_of::<usize>()).unwrap())
@@ -42,5 +153,6 @@ unsafe extern "C" fn malloc(size: usize) -> *mut u8 {
 
 #[no_mangle]
 unsafe extern "C" fn free(_ptr: *mut u8) {
-    // it is bump allocator - NOT MEMORY LEAKING
+    // `dealloc` needs the layout, which C callers do not keep: their buffers live as long as the
+    // renderer does
 }
@@ -0,0 +1,44 @@
+extern crate alloc;
+
+use {
+    alloc::vec::Vec,
+    noto_sans_mono_bitmap::{get_raster, get_raster_width, FontWeight, RasterHeight},
+};
+
+const WEIGHT: FontWeight = FontWeight::Regular;
+const HEIGHT: RasterHeight = RasterHeight::Size16;
+// printable ASCII
+const FIRST: char = ' ';
+const LAST: char = '~';
+
+/// `GlyphAtlas` of the render library
+#[repr(C)]
+struct GlyphAtlas {
+    coverage: *const u8,
+    first: u32,
+    count: u32,
+    width: usize,
+    height: usize,
+}
+
+/// Rasterizes the printable ASCII glyphs once, for the overlay to blit.
+#[no_mangle]
+extern "C" fn glyph_atlas() -> GlyphAtlas {
+    let (width, height) = (get_raster_width(WEIGHT, HEIGHT), HEIGHT.val());
+
+    let mut coverage = Vec::with_capacity((FIRST..=LAST).count() * width * height);
+    for c in FIRST..=LAST {
+        let glyph = get_raster(c, WEIGHT, HEIGHT).or_else(|| get_raster('?', WEIGHT, HEIGHT));
+        for row in glyph.unwrap().raster() {
+            coverage.extend_from_slice(row);
+        }
+    }
+
+    GlyphAtlas {
+        coverage: coverage.leak().as_ptr(),
+        first: FIRST as u32,
+        count: (FIRST..=LAST).count() as u32,
+        width,
+        height,
+    }
+}
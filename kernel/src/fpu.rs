@@ -0,0 +1,43 @@
+use {
+    core::arch::{asm, x86_64::__cpuid},
+    x86::controlregs::{cr0, cr0_write, cr4, cr4_write, xcr0, xcr0_write, Cr0, Cr4, Xcr0},
+};
+
+// CPUID.1:ECX
+const XSAVE: u32 = 1 << 26;
+const AVX: u32 = 1 << 28;
+
+/// Hands x87/SSE, and AVX when the cpu has it, to the render library, which is built with hardware
+/// floating point. The kernel itself is soft-float and nothing preempts the renderer, so the state
+/// set up here is the only one there is and it never has to be saved.
+///
+/// Must run on every cpu before it calls into the render library.
+pub fn init() {
+    unsafe {
+        let mut flags = cr0();
+        flags.remove(Cr0::CR0_EMULATE_COPROCESSOR | Cr0::CR0_TASK_SWITCHED);
+        flags.insert(Cr0::CR0_MONITOR_COPROCESSOR | Cr0::CR0_NUMERIC_ERROR);
+        cr0_write(flags);
+
+        let features = __cpuid(1).ecx;
+        let mut flags = cr4();
+        // FXSAVE/FXRSTOR and SSE instructions, unmasked SIMD exceptions raise #XM instead of #UD
+        flags.insert(Cr4::CR4_ENABLE_SSE | Cr4::CR4_UNMASKED_SSE);
+        if features & XSAVE != 0 {
+            flags.insert(Cr4::CR4_ENABLE_OS_XSAVE);
+        }
+        cr4_write(flags);
+
+        if features & XSAVE != 0 {
+            let mut state = xcr0() | Xcr0::XCR0_FPU_MMX_STATE | Xcr0::XCR0_SSE_STATE;
+            if features & AVX != 0 {
+                state |= Xcr0::XCR0_AVX_STATE;
+            }
+            xcr0_write(state);
+        }
+
+        // default control words: round to nearest, every exception masked
+        let mxcsr: u32 = 0x1F80;
+        asm!("fninit", "ldmxcsr [{}]", in(reg) &mxcsr, options(nostack));
+    }
+}
@@ -99,8 +99,21 @@ extern "C" fn putchar(c: c_int) {
 }
 
 #[no_mangle]
-unsafe extern "C" fn cpu_time_us() -> u64 {
-    x86::time::rdtsc() / 50000
+extern "C" fn cpu_time_us() -> u64 {
+    crate::time::now_us()
+}
+
+/// Writes a line straight to the first serial port: the logger would also draw it over the frames.
+#[no_mangle]
+unsafe extern "C" fn serial_puts(str: *const c_char) {
+    const COM1: u16 = 0x3F8;
+    for &byte in CStr::from_ptr(str).to_bytes().iter().chain(b"\n") {
+        // line status bit 5: the transmit register is empty
+        while x86::io::inb(COM1 + 5) & 0x20 == 0 {
+            core::hint::spin_loop();
+        }
+        x86::io::outb(COM1, byte);
+    }
 }
 
 #[no_mangle]
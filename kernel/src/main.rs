@@ -8,14 +8,17 @@
     slice_ptr_len,
     core_intrinsics
 )]
-#![feature(vec_into_raw_parts)]
 
 mod alloc;
+mod font;
+mod fpu;
 mod libc;
 mod model;
+mod smp;
+mod time;
 
 use {
-    bootloader_api::{entry_point, BootInfo, BootloaderConfig},
+    bootloader_api::{config::Mapping, entry_point, info::PixelFormat, BootInfo, BootloaderConfig},
     bootloader_boot_config::LevelFilter,
     core::{fmt::Write, panic::PanicInfo},
 };
@@ -23,6 +26,8 @@ use {
 pub const CONFIG: BootloaderConfig = {
     let mut config = BootloaderConfig::new_default();
     config.kernel_stack_size *= 1024;
+    // page tables, ACPI tables and the local APIC are reached through it
+    config.mappings.physical_memory = Some(Mapping::Dynamic);
     config
 };
 
@@ -38,25 +43,58 @@ mod pic {
     pub fn init() {}
 }
 
+/// `Display` of the render library
+#[repr(C)]
+struct Display {
+    ptr: *mut u8,
+    len: usize,
+    width: usize,
+    height: usize,
+    stride: usize,
+    bytes_per_pixel: usize,
+    format: u32,
+}
+
 #[link(name = "render")]
 extern "C" {
-    fn kernel_main(ptr: *mut u8, len: u32);
+    fn kernel_main(display: Display);
 }
 
 fn kernel_entry(info: &'static mut BootInfo) -> ! {
     pic::init();
 
     unsafe {
-        alloc::ALLOC.init();
-
+        let phys = info.physical_memory_offset.into_option();
+        let rsdp = info.rsdp_addr.into_option();
+        let regions = &info.memory_regions;
+        // `CONFIG` always asks for the physical memory mapping
+        alloc::ALLOC.init(phys.unwrap(), regions);
         let framebuffer = info.framebuffer.as_mut().unwrap();
 
         let info = framebuffer.info();
         let buf = framebuffer.buffer_mut() as *mut [u8];
 
         bootloader_x86_64_common::init_logger(&mut *buf, info, LevelFilter::Info, true, true);
-
-        kernel_main(buf as *mut u8, buf.len() as u32);
+        log::info!("heap: {} MiB", alloc::ALLOC.size() >> 20);
+        fpu::init();
+        time::calibrate_tsc();
+        log::info!("tsc: {} kHz", time::tsc_hz() / 1000);
+        smp::init(phys, rsdp, regions);
+
+        kernel_main(Display {
+            ptr: buf as *mut u8,
+            len: buf.len(),
+            width: info.width,
+            height: info.height,
+            stride: info.stride,
+            bytes_per_pixel: info.bytes_per_pixel,
+            format: match info.pixel_format {
+                PixelFormat::Rgb => 0,
+                PixelFormat::Bgr => 1,
+                PixelFormat::U8 => 2,
+                _ => 3,
+            },
+        });
     }
 
     loop {}
@@ -1,15 +1,11 @@
-extern crate alloc;
-
-use alloc::vec::Vec;
+use core::mem;
 
+// baked by build.rs and only read by the renderer
+#[allow(dead_code)]
+#[repr(C)]
 pub struct Vertex {
     position: [f32; 3],
-}
-
-#[repr(C)]
-pub struct Triangle {
-    vertices: [Vertex; 3],
-    uv: [[f32; 3]; 3],
+    uv: [f32; 2],
 }
 
 #[repr(C)]
@@ -22,36 +18,83 @@ struct Texture {
 
 #[repr(C)]
 struct ObjRepr {
-    triangles: *mut Triangle,
-    triangles_len: usize,
+    vertices: *const Vertex,
+    vertices_len: usize,
+    // three per triangle
+    indices: *const u32,
+    indices_len: usize,
     texture: Texture,
 }
 
+const MESH_MAGIC: [u8; 4] = *b"MESH";
+const MESH_VERSION: u32 = 2;
+
+/// Start of a mesh blob baked by build.rs, `vertices_len` of `Vertex` and `indices_len` of `u32`
+/// follow it.
+#[repr(C)]
+struct MeshHeader {
+    magic: [u8; 4],
+    version: u32,
+    vertices_len: u32,
+    indices_len: u32,
+}
+
+/// Embedded bytes aligned as `A`, so that they can be read in place as a `#[repr(C)]` type.
+#[repr(C)]
+struct AlignedAs<A, B: ?Sized> {
+    _align: [A; 0],
+    bytes: B,
+}
+
+struct Mesh {
+    vertices: *const Vertex,
+    vertices_len: usize,
+    indices: *const u32,
+    indices_len: usize,
+}
+
+fn mesh(blob: &'static AlignedAs<MeshHeader, [u8]>) -> Mesh {
+    let blob = &blob.bytes;
+    assert!(blob.len() >= mem::size_of::<MeshHeader>());
+
+    let header = unsafe { &*(blob.as_ptr() as *const MeshHeader) };
+    assert!(header.magic == MESH_MAGIC && header.version == MESH_VERSION, "stale mesh blob");
+
+    let (vertices_len, indices_len) = (header.vertices_len as usize, header.indices_len as usize);
+    let vertices = mem::size_of::<MeshHeader>();
+    let indices = vertices + vertices_len * mem::size_of::<Vertex>();
+    assert_eq!(blob.len(), indices + indices_len * mem::size_of::<u32>());
+
+    unsafe {
+        Mesh {
+            vertices: blob.as_ptr().add(vertices) as *const Vertex,
+            vertices_len,
+            indices: blob.as_ptr().add(indices) as *const u32,
+            indices_len,
+        }
+    }
+}
+
 #[rustfmt::skip]
 macro_rules! define_model {
-    (obj: $obj:literal texture: $image:literal => $name:ident) => {
+    (mesh: $mesh:literal texture: $image:literal => $name:ident) => {
         const _: () = {
             image::load!($image in IMG);
-            
-            static OBJ: &str = include_str!($obj);
-            
-            #[no_mangle]
-            extern "C" fn $name() -> ObjRepr {
-                let obj = wavefront::Obj::from_lines(OBJ.lines()).unwrap();
 
-                let repr = obj
-                    .triangles()
-                    .map(|t| Triangle {
-                        vertices: t.map(|v| Vertex { position: v.position() }),
-                        uv: t.map(|v| v.uv().unwrap()),
-                    })
-                    .collect::<Vec<_>>();
+            static MESH: &AlignedAs<MeshHeader, [u8]> = &AlignedAs {
+                _align: [],
+                bytes: *include_bytes!(concat!(env!("OUT_DIR"), "/", $mesh, ".mesh")),
+            };
 
-                let (triangles, triangles_len, _) = repr.into_raw_parts();
+            #[no_mangle]
+            extern "C" fn $name() -> ObjRepr {
+                let Mesh { vertices, vertices_len, indices, indices_len } = mesh(MESH);
                 let (img, w, h) = &IMG;
                 ObjRepr { 
-                    triangles,
-                    triangles_len, 
+                    vertices,
+                    vertices_len,
+                    indices,
+                    indices_len,
                     texture: Texture {
                         ptr: img.as_ptr(),
                         len: img.len(),
@@ -63,8 +106,9 @@ macro_rules! define_model {
     };
 }
 
+// baked from `assets/flanker_fix.obj`
 define_model!(
-    obj: "../assets/flanker_fix.obj"
+    mesh: "flanker_fix"
     texture: "../assets/flanker.jpg"
     => load_elemental
 );
@@ -0,0 +1,364 @@
+extern crate alloc;
+
+use {
+    crate::{fpu, time},
+    alloc::alloc::alloc,
+    bootloader_api::info::{MemoryRegion, MemoryRegionKind},
+    core::{
+        alloc::Layout,
+        ffi::c_void,
+        hint::spin_loop,
+        mem,
+        ptr::{self, addr_of, addr_of_mut},
+        slice,
+        sync::atomic::{AtomicPtr, AtomicU32, AtomicUsize, Ordering},
+    },
+    x86::{controlregs::cr3, msr},
+};
+
+pub const MAX_CPUS: usize = 16;
+const AP_STACK: usize = 64 * 1024;
+
+/// Physical page the application processors start at; the SIPI vector is its page number
+const TRAMPOLINE: u64 = 0x8000;
+const LOW_MEMORY_END: u64 = 0x10_0000;
+
+const PRESENT: u64 = 1 << 0;
+const WRITABLE: u64 = 1 << 1;
+const HUGE: u64 = 1 << 7;
+const ADDR_MASK: u64 = 0x000F_FFFF_FFFF_F000;
+
+// Real mode -> long mode in one step: PAE and EFER.LME are set before CR0.PE and CR0.PG are
+// enabled together, then a far jump lands in the 64-bit code segment. The page is identity mapped
+// in the bootstrap processor's tables, so the AP reuses them as they are.
+core::arch::global_asm!(
+    ".pushsection .text.smp_trampoline, \"ax\"",
+    ".global smp_trampoline_start",
+    ".global smp_trampoline_end",
+    ".global smp_cr3",
+    ".global smp_stacks",
+    ".global smp_entry",
+    ".code16",
+    "smp_trampoline_start:",
+    "    cli",
+    "    cld",
+    "    xor ax, ax",
+    "    mov ds, ax",
+    "    mov ss, ax",
+    "    lgdt [{base} + smp_gdt_ptr - smp_trampoline_start]",
+    "    mov eax, cr4",
+    "    or eax, 1 << 5",
+    "    mov cr4, eax",
+    "    mov eax, dword ptr [{base} + smp_cr3 - smp_trampoline_start]",
+    "    mov cr3, eax",
+    // EFER.LME and EFER.NXE, the bootloader maps data as no-execute
+    "    mov ecx, 0xC0000080",
+    "    rdmsr",
+    "    or eax, (1 << 8) | (1 << 11)",
+    "    wrmsr",
+    "    mov eax, cr0",
+    "    or eax, (1 << 31) | (1 << 16) | 1",
+    "    mov cr0, eax",
+    "    .byte 0x66, 0xEA",
+    "    .long {base} + smp_long_mode - smp_trampoline_start",
+    "    .word 0x08",
+    ".code64",
+    "smp_long_mode:",
+    "    mov ax, 0x10",
+    "    mov ds, ax",
+    "    mov es, ax",
+    "    mov ss, ax",
+    "    xor ax, ax",
+    "    mov fs, ax",
+    "    mov gs, ax",
+    // the stack is looked up by the initial APIC id, so an AP that starts late still gets its own
+    "    mov eax, 1",
+    "    cpuid",
+    "    shr ebx, 24",
+    "    mov rax, qword ptr [{base} + smp_stacks - smp_trampoline_start]",
+    "    mov rsp, qword ptr [rax + rbx * 8]",
+    "    mov edi, ebx",
+    "    mov rax, qword ptr [{base} + smp_entry - smp_trampoline_start]",
+    "    call rax",
+    "    ud2",
+    ".align 8",
+    "smp_gdt:",
+    "    .quad 0",
+    "    .quad 0x00AF9A000000FFFF",
+    "    .quad 0x00CF92000000FFFF",
+    "smp_gdt_ptr:",
+    "    .word smp_gdt_ptr - smp_gdt - 1",
+    "    .long {base} + smp_gdt - smp_trampoline_start",
+    ".align 8",
+    "smp_cr3: .quad 0",
+    "smp_stacks: .quad 0",
+    "smp_entry: .quad 0",
+    "smp_trampoline_end:",
+    ".popsection",
+    base = const TRAMPOLINE,
+);
+
+extern "C" {
+    static smp_trampoline_start: u8;
+    static smp_trampoline_end: u8;
+    static smp_cr3: u64;
+    static smp_stacks: u64;
+    static smp_entry: u64;
+}
+
+pub type Job = extern "C" fn(ctx: *mut c_void, cpu: u32);
+
+/// Processors that take jobs, the bootstrap one included
+static CPUS: AtomicU32 = AtomicU32::new(1);
+/// APIC id of the processor `init` is waiting for, see `claim`
+static STARTING: AtomicU32 = AtomicU32::new(NONE);
+const NONE: u32 = u32::MAX;
+/// Top of the stack of each processor by APIC id, read by the trampoline
+static mut AP_STACKS: [u64; 256] = [0; 256];
+
+static JOB: AtomicUsize = AtomicUsize::new(0);
+static JOB_CTX: AtomicPtr<c_void> = AtomicPtr::new(ptr::null_mut());
+static JOB_GEN: AtomicU32 = AtomicU32::new(0);
+static JOB_DONE: AtomicU32 = AtomicU32::new(0);
+
+/// Runs `job` on every online processor, the caller included, and returns once all are done.
+#[no_mangle]
+extern "C" fn smp_run(job: Job, ctx: *mut c_void) {
+    let aps = CPUS.load(Ordering::Acquire) - 1;
+
+    JOB.store(job as usize, Ordering::Relaxed);
+    JOB_CTX.store(ctx, Ordering::Relaxed);
+    JOB_DONE.store(0, Ordering::Relaxed);
+    JOB_GEN.fetch_add(1, Ordering::Release);
+
+    job(ctx, 0);
+    while JOB_DONE.load(Ordering::Acquire) < aps {
+        spin_loop();
+    }
+}
+
+/// Ends the start of processor `apic_id`. True only for whichever comes first: `init` giving up on
+/// it, or the processor arriving in time.
+fn claim(apic_id: u32) -> bool {
+    STARTING.compare_exchange(apic_id, NONE, Ordering::AcqRel, Ordering::Acquire).is_ok()
+}
+
+extern "C" fn ap_main(apic_id: u64) -> ! {
+    // both stay as they are until `init` sees the swap below
+    let cpu = CPUS.load(Ordering::Acquire);
+    let mut seen = JOB_GEN.load(Ordering::Acquire);
+    if !claim(apic_id as u32) {
+        // came up after `init` timed out: it is not counted, so it must not take jobs
+        loop {
+            unsafe { core::arch::asm!("cli; hlt") };
+        }
+    }
+    fpu::init();
+
+    loop {
+        let gen = JOB_GEN.load(Ordering::Acquire);
+        if gen == seen {
+            spin_loop();
+            continue;
+        }
+        seen = gen;
+
+        let job: Job = unsafe { mem::transmute(JOB.load(Ordering::Relaxed)) };
+        job(JOB_CTX.load(Ordering::Relaxed), cpu);
+        JOB_DONE.fetch_add(1, Ordering::Release);
+    }
+}
+
+struct LocalApic(*mut u32);
+
+impl LocalApic {
+    const ID: usize = 0x20;
+    const SVR: usize = 0xF0;
+    const ICR_LOW: usize = 0x300;
+    const ICR_HIGH: usize = 0x310;
+
+    const INIT: u32 = 0x4500;
+    const STARTUP: u32 = 0x4600;
+    const PENDING: u32 = 1 << 12;
+
+    unsafe fn read(&self, reg: usize) -> u32 {
+        self.0.byte_add(reg).read_volatile()
+    }
+
+    unsafe fn write(&self, reg: usize, val: u32) {
+        self.0.byte_add(reg).write_volatile(val)
+    }
+
+    unsafe fn ipi(&self, apic_id: u8, icr: u32) {
+        self.write(Self::ICR_HIGH, (apic_id as u32) << 24);
+        self.write(Self::ICR_LOW, icr);
+        while self.read(Self::ICR_LOW) & Self::PENDING != 0 {
+            spin_loop();
+        }
+    }
+}
+
+/// Page table frames below 1 MiB that the bootloader left usable.
+struct LowFrames<'a> {
+    regions: &'a [MemoryRegion],
+    next: u64,
+}
+
+impl LowFrames<'_> {
+    fn usable(&self, frame: u64) -> bool {
+        self.regions.iter().any(|r| {
+            r.kind == MemoryRegionKind::Usable && r.start <= frame && frame + 0x1000 <= r.end
+        })
+    }
+
+    fn alloc(&mut self) -> Option<u64> {
+        while self.next < LOW_MEMORY_END {
+            let frame = self.next;
+            self.next += 0x1000;
+            if frame != TRAMPOLINE && self.usable(frame) {
+                return Some(frame);
+            }
+        }
+        None
+    }
+}
+
+unsafe fn identity_map(phys: u64, page: u64, frames: &mut LowFrames) -> Option<()> {
+    let mut table = (phys + (cr3() & ADDR_MASK)) as *mut u64;
+    for level in (1..4).rev() {
+        let entry = table.add(((page >> (12 + 9 * level)) & 0x1FF) as usize);
+        if *entry & PRESENT == 0 {
+            let frame = frames.alloc()?;
+            ptr::write_bytes((phys + frame) as *mut u8, 0, 0x1000);
+            *entry = frame | PRESENT | WRITABLE;
+        } else if *entry & HUGE != 0 {
+            return None;
+        }
+        table = (phys + (*entry & ADDR_MASK)) as *mut u64;
+    }
+
+    let entry = table.add(((page >> 12) & 0x1FF) as usize);
+    if *entry & PRESENT != 0 && *entry & ADDR_MASK != page {
+        return None;
+    }
+    *entry = page | PRESENT | WRITABLE;
+    x86::tlb::flush(page as usize);
+    Some(())
+}
+
+unsafe fn read<T: Copy>(ptr: *const u8, offset: usize) -> T {
+    ptr.add(offset).cast::<T>().read_unaligned()
+}
+
+/// Local APIC ids of the enabled processors listed in the ACPI MADT.
+unsafe fn apic_ids(phys: u64, rsdp: u64) -> impl Iterator<Item = u8> {
+    let rsdp = (phys + rsdp) as *const u8;
+    let (sdt, entry_len) = if read::<u8>(rsdp, 15) >= 2 {
+        (read::<u64>(rsdp, 24), 8)
+    } else {
+        (read::<u32>(rsdp, 16) as u64, 4)
+    };
+    let sdt = (phys + sdt) as *const u8;
+
+    let madt = (36..read::<u32>(sdt, 4) as usize)
+        .step_by(entry_len)
+        .map(|off| match entry_len {
+            8 => read::<u64>(sdt, off),
+            _ => read::<u32>(sdt, off) as u64,
+        })
+        .map(|addr| (phys + addr) as *const u8)
+        .find(|&table| slice::from_raw_parts(table, 4) == b"APIC");
+
+    let (madt, len) = match madt {
+        Some(madt) => (madt, read::<u32>(madt, 4) as usize),
+        None => (ptr::null(), 0),
+    };
+
+    // entries follow the header and the local APIC address and flags
+    let mut off = 44;
+    core::iter::from_fn(move || {
+        while off + 2 <= len {
+            let (kind, entry) = (read::<u8>(madt, off), off);
+            off += read::<u8>(madt, off + 1).max(2) as usize;
+            // processor local APIC, enabled or online capable
+            if kind == 0 && read::<u32>(madt, entry + 4) & 0b11 != 0 {
+                return Some(read::<u8>(madt, entry + 3));
+            }
+        }
+        None
+    })
+}
+
+unsafe fn trampoline_var(phys: u64, var: *const u64) -> *mut u64 {
+    let off = var as usize - addr_of!(smp_trampoline_start) as usize;
+    (phys + TRAMPOLINE + off as u64) as *mut u64
+}
+
+/// Starts the application processors with INIT-SIPI-SIPI, they wait in `ap_main` for `smp_run`.
+pub fn init(phys: Option<u64>, rsdp: Option<u64>, regions: &[MemoryRegion]) {
+    let (Some(phys), Some(rsdp)) = (phys, rsdp) else {
+        log::warn!("smp: no physical memory mapping or RSDP, running on a single cpu");
+        return;
+    };
+
+    let mut frames = LowFrames { regions, next: 0x1000 };
+    if !frames.usable(TRAMPOLINE) || unsafe { cr3() } >= 1 << 32 {
+        log::warn!("smp: trampoline page is not available, running on a single cpu");
+        return;
+    }
+
+    unsafe {
+        if identity_map(phys, TRAMPOLINE, &mut frames).is_none() {
+            log::warn!("smp: cannot map the trampoline, running on a single cpu");
+            return;
+        }
+
+        let start = addr_of!(smp_trampoline_start);
+        let len = addr_of!(smp_trampoline_end) as usize - start as usize;
+        ptr::copy_nonoverlapping(start, (phys + TRAMPOLINE) as *mut u8, len);
+        *trampoline_var(phys, addr_of!(smp_cr3)) = cr3();
+        *trampoline_var(phys, addr_of!(smp_entry)) = ap_main as usize as u64;
+        *trampoline_var(phys, addr_of!(smp_stacks)) = addr_of!(AP_STACKS) as u64;
+
+        let apic_base = msr::rdmsr(msr::IA32_APIC_BASE) & ADDR_MASK;
+        let lapic = LocalApic((phys + apic_base) as *mut u32);
+        lapic.write(LocalApic::SVR, lapic.read(LocalApic::SVR) | 0x100);
+        let bsp = (lapic.read(LocalApic::ID) >> 24) as u8;
+
+        for apic_id in apic_ids(phys, rsdp).filter(|&id| id != bsp) {
+            let cpu = CPUS.load(Ordering::Relaxed);
+            if cpu as usize == MAX_CPUS {
+                break;
+            }
+
+            let stack = alloc(Layout::from_size_align(AP_STACK, 16).unwrap());
+            (*addr_of_mut!(AP_STACKS))[apic_id as usize] = stack.add(AP_STACK) as u64;
+            STARTING.store(apic_id as u32, Ordering::Release);
+            let arrived = || STARTING.load(Ordering::Acquire) != apic_id as u32;
+
+            lapic.ipi(apic_id, LocalApic::INIT);
+            time::delay_us(10_000);
+            for _ in 0..2 {
+                if arrived() {
+                    break;
+                }
+                lapic.ipi(apic_id, LocalApic::STARTUP | (TRAMPOLINE >> 12) as u32);
+                for _ in 0..100 {
+                    if arrived() {
+                        break;
+                    }
+                    time::delay_us(100);
+                }
+            }
+
+            // the processor is counted once it has claimed the start itself
+            if !claim(apic_id as u32) {
+                CPUS.store(cpu + 1, Ordering::Release);
+            } else {
+                log::warn!("smp: cpu with apic id {apic_id} did not start");
+            }
+        }
+    }
+
+    log::info!("smp: {} cpus online", CPUS.load(Ordering::Relaxed));
+}
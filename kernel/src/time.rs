@@ -0,0 +1,62 @@
+use {
+    core::sync::atomic::{AtomicU64, Ordering},
+    x86::{
+        io::{inb, outb},
+        time::rdtsc,
+    },
+};
+
+/// Input clock of the 8253/8254 programmable interval timer
+pub const PIT_HZ: u64 = 1_193_182;
+
+const PIT_CH2: u16 = 0x42;
+const PIT_CMD: u16 = 0x43;
+// bit 0 gates channel 2, bit 1 drives the speaker, bit 5 reads back its output
+const PORT_B: u16 = 0x61;
+
+/// Busy-waits for `ticks` PIT periods on channel 2, which does not need interrupts.
+pub fn pit_wait(mut ticks: u64) {
+    while ticks > 0 {
+        let chunk = ticks.min(0xFFFF);
+        unsafe {
+            let port_b = inb(PORT_B) & !0b11;
+            outb(PORT_B, port_b);
+            // channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+            outb(PIT_CMD, 0b1011_0000);
+            outb(PIT_CH2, chunk as u8);
+            outb(PIT_CH2, (chunk >> 8) as u8);
+            outb(PORT_B, port_b | 1);
+            while inb(PORT_B) & 0x20 == 0 {
+                core::hint::spin_loop();
+            }
+        }
+        ticks -= chunk;
+    }
+}
+
+pub fn delay_us(us: u64) {
+    pit_wait((us * PIT_HZ).div_ceil(1_000_000));
+}
+
+static TSC_HZ: AtomicU64 = AtomicU64::new(0);
+
+/// Measures the time stamp counter against the PIT. The counter is assumed to be invariant: the
+/// same rate on every cpu whatever their power state, as on anything since Nehalem.
+pub fn calibrate_tsc() {
+    // 50 ms, so that programming the PIT stays in the noise
+    let ticks = PIT_HZ / 20;
+    let start = unsafe { rdtsc() };
+    pit_wait(ticks);
+    let elapsed = unsafe { rdtsc() } - start;
+    TSC_HZ.store(elapsed * PIT_HZ / ticks, Ordering::Relaxed);
+}
+
+pub fn tsc_hz() -> u64 {
+    TSC_HZ.load(Ordering::Relaxed)
+}
+
+/// Microseconds since the cpu was reset, once `calibrate_tsc` ran.
+pub fn now_us() -> u64 {
+    let hz = TSC_HZ.load(Ordering::Relaxed).max(1);
+    (unsafe { rdtsc() } as u128 * 1_000_000 / hz as u128) as u64
+}
@@ -13,6 +13,8 @@ fn main() {
     } else {
         cmd.arg("-drive").arg(format!("format=raw,file={bios}"));
     }
+    // extra qemu flags, e.g. `cargo run -- -smp 4`
+    cmd.args(std::env::args().skip(1));
     let mut child = cmd.spawn().unwrap();
     child.wait().unwrap();
 }